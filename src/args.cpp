@@ -1,48 +1,397 @@
 #include <iostream>
+#include <random>
+#include <sstream>
+#include <sched.h>
 #include "utils.h"
 #include "args.h"
+#include "store.h"
 #include "cxxopts.hpp"
 
 double duration = 0.0;
+double gracePeriod = 1.0;
+long long maxMemory = 0;
+double maxCpuTime = 0.0;
+double memoryInterval = 0.0;
+int runs = 1;
+int jobs = 1;
+std::vector<int> scaleLevels;
+std::vector<int> cpuSweep;
+int warmup = 0;
+double precision = 0.0;
+int maxRuns = 0;
+double maxTime = 0.0;
 std::string outStream;
+Format outputFormat = Format::Text;
 bool verbose = false;
+bool calibrateHarness = false;
+bool useCgroup = false;
+bool subtractOverhead = false;
+bool excludeOutliers = false;
+std::string saveBaselineName;
+std::string compareBaselineName;
+double regressionThreshold = 0.05;
+std::string historyPath;
+SpawnMethod spawnMethod = SpawnMethod::Fork;
+std::vector<CounterSpec> counters;
 std::vector<std::string> command;
+std::vector<std::vector<std::string>> commands;
+std::vector<Parameter> parameters;
+Order runOrder = Order::Blocked;
+unsigned long seed = 0;
+
+// -P takes a name and a list of values, which cxxopts cannot express, so
+// those are taken out before the rest is parsed
+static std::vector<char*> extractParameters(int argc, char** argv) {
+    std::vector<char*> remaining = {argv[0]};
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "--") {
+            remaining.insert(remaining.end(), argv + i, argv + argc);
+            break;
+        }
+
+        if (arg != "-P" && arg != "--parameter") {
+            remaining.push_back(argv[i]);
+            continue;
+        }
+
+        if (i + 2 >= argc) {
+            std::cerr << "Error: " << arg << " needs a name and a list of values." << std::endl;
+            dead(1);
+        }
+
+        Parameter parameter;
+        parameter.name = argv[i + 1];
+
+        std::istringstream values(argv[i + 2]);
+        std::string value;
+        while (std::getline(values, value, ',')) {
+            parameter.values.push_back(value);
+        }
+
+        if (parameter.values.empty()) {
+            std::cerr << "Error: Parameter " << parameter.name << " has no values." << std::endl;
+            dead(1);
+        }
+
+        parameters.push_back(parameter);
+        i += 2;
+    }
+
+    return remaining;
+}
 
 void handleArguments(int argc, char** argv) {
+    std::vector<char*> remaining = extractParameters(argc, argv);
+
     cxxopts::Options options("timez", "A simple utility for measuring the execution time and resource usage of commands.");
 
     options.add_options()
+        ("c,command", "A whole command line to compare, repeat it for every command", cxxopts::value<std::string>())
+        ("calibrate", "Measure the overhead of launching a no-op command")
+        ("cgroup", "Run every measured run in a fresh cgroup v2 and account for the whole process tree")
+        ("compare-baseline", "Compare with the named baseline and exit with status 2 if a metric regressed", cxxopts::value<std::string>())
+        ("counters", "Comma separated performance counters, e.g. cycles,instructions,cache-misses,branch-misses", cxxopts::value<std::string>())
+        ("cpus-sweep", "Pin the command to each number of CPUs in turn, e.g. 1..8 or 1,2,4", cxxopts::value<std::string>())
         ("d,duration", "Execute command for specific duration", cxxopts::value<double>()) // Changed to double
+        ("exclude-outliers", "Leave runs flagged as outliers out of the summary")
+        ("f,format", "Write every run as a record: json, csv or markdown, to --out when given", cxxopts::value<std::string>())
+        ("g,grace", "Seconds between SIGTERM and SIGKILL once the duration is exceeded, 0 kills at once", cxxopts::value<double>())
         ("h,help", "Print help message")
-        ("o,out", "Output stream", cxxopts::value<std::string>())
+        ("history", "File every benchmark is appended to, by default in ~/.local/share/timez", cxxopts::value<std::string>())
+        ("j,jobs", "Number of instances of the command to run concurrently", cxxopts::value<int>())
+        ("max-cpu-time", "CPU time limit of every run in seconds", cxxopts::value<double>())
+        ("max-memory", "Memory limit of every run, e.g. 512M or 2G", cxxopts::value<std::string>())
+        ("max-runs", "Upper bound on the number of runs in --precision mode", cxxopts::value<int>())
+        ("max-time", "Upper bound on the total time in seconds in --precision mode", cxxopts::value<double>())
+        ("no-history", "Do not append the results to the history")
+        ("o,out", "File to write the report, or the records with --format, to", cxxopts::value<std::string>())
+        ("order", "Order of the runs of several benchmarks: blocked, interleaved or shuffle", cxxopts::value<std::string>())
+        ("P,parameter", "Benchmark every value of a parameter, e.g. -P threads 1,2,4, used as {threads} in the command", cxxopts::value<std::string>())
+        ("p,precision", "Run until the 95% confidence interval of the mean runtime is within this relative width, e.g. 1%", cxxopts::value<std::string>())
+        ("r,runs", "Number of times to run the command", cxxopts::value<int>())
+        ("w,warmup", "Number of warmup runs excluded from the results", cxxopts::value<int>())
+        ("sample-memory", "Sample the memory of the command from /proc every given number of seconds", cxxopts::value<double>())
+        ("save-baseline", "Save the statistics of this benchmark as the named baseline", cxxopts::value<std::string>())
+        ("seed", "Seed of the --order=shuffle schedule, random by default", cxxopts::value<unsigned long>())
+        ("scale", "Repeat the concurrent benchmark at each level, e.g. 1,2,4,8", cxxopts::value<std::string>())
+        ("spawn", "Process launch method: fork, vfork, posix_spawn or clone3", cxxopts::value<std::string>())
+        ("subtract-overhead", "Subtract the calibrated overhead from every runtime, implies --calibrate")
+        ("threshold", "Relative slowdown --compare-baseline tolerates, e.g. 5%", cxxopts::value<std::string>())
         ("v,verbose", "Verbose output", cxxopts::value<bool>()->default_value("false"));
 
-    auto result = options.parse(argc, argv);
+    auto result = options.parse(remaining.size(), remaining.data());
+
+    if (result.count("calibrate")) {
+        calibrateHarness = true;
+    }
+
+    if (result.count("subtract-overhead")) {
+        calibrateHarness = true;
+        subtractOverhead = true;
+    }
+
+    if (result.count("exclude-outliers")) {
+        excludeOutliers = true;
+    }
+
+    if (result.count("save-baseline")) {
+        saveBaselineName = result["save-baseline"].as<std::string>();
+    }
+
+    if (result.count("compare-baseline")) {
+        compareBaselineName = result["compare-baseline"].as<std::string>();
+    }
+
+    if (result.count("threshold")) {
+        regressionThreshold = parsePercentage(result["threshold"].as<std::string>());
+
+        if (regressionThreshold < 0.0) {
+            std::cerr << "Error: --threshold must be a percentage." << std::endl;
+            dead(1);
+        }
+    }
+
+    if (result.count("no-history")) {
+        historyPath.clear();
+    } else if (result.count("history")) {
+        historyPath = result["history"].as<std::string>();
+    } else {
+        historyPath = defaultHistoryPath();
+    }
+
+    if (result.count("cgroup")) {
+        useCgroup = true;
+    }
+
+    if (result.count("counters")) {
+        if (!parseCounters(result["counters"].as<std::string>(), counters)) {
+            std::cerr << "Error: Unknown performance counter in --counters." << std::endl;
+            dead(1);
+        }
+    }
+
+    if (result.count("cpus-sweep")) {
+        cpu_set_t allowed;
+        sched_getaffinity(0, sizeof(allowed), &allowed);
+
+        if (!parseCountList(result["cpus-sweep"].as<std::string>(), cpuSweep)) {
+            std::cerr << "Error: --cpus-sweep needs a list of positive CPU counts." << std::endl;
+            dead(1);
+        }
+
+        for (int cpus : cpuSweep) {
+            if (cpus > CPU_COUNT(&allowed)) {
+                std::cerr << "Error: Only " << CPU_COUNT(&allowed) << " CPU(s) are available for --cpus-sweep." << std::endl;
+                dead(1);
+            }
+        }
+    }
 
     if (result.count("duration")) {
         duration = result["duration"].as<double>();
     }
 
+    if (result.count("grace")) {
+        gracePeriod = result["grace"].as<double>();
+
+        if (gracePeriod < 0.0) {
+            std::cerr << "Error: --grace cannot be negative." << std::endl;
+            dead(1);
+        }
+    }
+
     if (result.count("help")) {
         std::cout << options.help() << std::endl;
         dead(0);
     }
 
+    if (result.count("format")) {
+        std::string format = result["format"].as<std::string>();
+
+        if (format == "json") {
+            outputFormat = Format::Json;
+        } else if (format == "csv") {
+            outputFormat = Format::Csv;
+        } else if (format == "markdown") {
+            outputFormat = Format::Markdown;
+        } else if (format == "text") {
+            outputFormat = Format::Text;
+        } else {
+            std::cerr << "Error: Unknown format. Use json, csv or markdown." << std::endl;
+            dead(1);
+        }
+    }
+
     if (result.count("out")) {
         outStream = result["out"].as<std::string>();
     }
 
+    if (result.count("precision")) {
+        precision = parsePercentage(result["precision"].as<std::string>());
+
+        if (precision <= 0.0) {
+            std::cerr << "Error: --precision must be a positive percentage." << std::endl;
+            dead(1);
+        }
+    }
+
+    if (result.count("jobs")) {
+        jobs = result["jobs"].as<int>();
+
+        if (jobs < 1) {
+            std::cerr << "Error: --jobs must be at least 1." << std::endl;
+            dead(1);
+        }
+    }
+
+    if (result.count("scale")) {
+        if (!parseCountList(result["scale"].as<std::string>(), scaleLevels)) {
+            std::cerr << "Error: --scale needs a list of positive counts." << std::endl;
+            dead(1);
+        }
+    }
+
+    // Every child launched while counters are open inherits them, so
+    // concurrent instances would count each other
+    if ((jobs > 1 || !scaleLevels.empty()) && !counters.empty()) {
+        std::cerr << "Error: --counters cannot be combined with --jobs or --scale." << std::endl;
+        dead(1);
+    }
+
+    if (result.count("max-cpu-time")) {
+        maxCpuTime = result["max-cpu-time"].as<double>();
+
+        if (maxCpuTime <= 0.0) {
+            std::cerr << "Error: --max-cpu-time must be positive." << std::endl;
+            dead(1);
+        }
+    }
+
+    if (result.count("max-memory")) {
+        maxMemory = parseSize(result["max-memory"].as<std::string>());
+
+        if (maxMemory <= 0) {
+            std::cerr << "Error: Invalid size for --max-memory." << std::endl;
+            dead(1);
+        }
+    }
+
+    if (result.count("max-runs")) {
+        maxRuns = result["max-runs"].as<int>();
+    }
+
+    if (result.count("max-time")) {
+        maxTime = result["max-time"].as<double>();
+    }
+
+    if (result.count("runs")) {
+        runs = result["runs"].as<int>();
+
+        if (runs < 1) {
+            std::cerr << "Error: --runs must be at least 1." << std::endl;
+            dead(1);
+        }
+    }
+
+    if (result.count("warmup")) {
+        warmup = result["warmup"].as<int>();
+
+        if (warmup < 0) {
+            std::cerr << "Error: --warmup cannot be negative." << std::endl;
+            dead(1);
+        }
+    }
+
+    if (result.count("sample-memory")) {
+        memoryInterval = result["sample-memory"].as<double>();
+
+        if (memoryInterval <= 0.0) {
+            std::cerr << "Error: --sample-memory must be a positive interval." << std::endl;
+            dead(1);
+        }
+    }
+
+    if (result.count("order")) {
+        std::string order = result["order"].as<std::string>();
+
+        if (order == "blocked") {
+            runOrder = Order::Blocked;
+        } else if (order == "interleaved") {
+            runOrder = Order::Interleaved;
+        } else if (order == "shuffle") {
+            runOrder = Order::Shuffle;
+        } else {
+            std::cerr << "Error: Unknown order. Use blocked, interleaved or shuffle." << std::endl;
+            dead(1);
+        }
+    }
+
+    // The seed is always known so a shuffled schedule can be repeated
+    if (result.count("seed")) {
+        seed = result["seed"].as<unsigned long>();
+    } else {
+        seed = std::random_device()();
+    }
+
+    if (result.count("spawn")) {
+        if (!parseSpawnMethod(result["spawn"].as<std::string>(), spawnMethod)) {
+            std::cerr << "Error: Unknown spawn method. Use fork, vfork, posix_spawn or clone3." << std::endl;
+            dead(1);
+        }
+    }
+
     if (result.count("verbose")) {
         verbose = result["verbose"].as<bool>();
     }
 
-    for (int i = 1; i < argc; i++) {
-        if (argv[i][0] == '-')
-            break;
-        command.push_back(argv[i]);
+    // Everything that is not an option, including all arguments after --,
+    // makes up the command
+    command = result.unmatched();
+
+    // Every -c is a whole command line of its own, and the commands are
+    // compared with each other
+    for (const auto& argument : result.arguments()) {
+        if (argument.key() != "command") {
+            continue;
+        }
+
+        std::vector<std::string> words;
+
+        if (!splitCommand(argument.value(), words) || words.empty()) {
+            std::cerr << "Error: Cannot parse command '" << argument.value() << "'." << std::endl;
+            dead(1);
+        }
+
+        commands.push_back(words);
+    }
+
+    if (!commands.empty() && !command.empty()) {
+        std::cerr << "Error: Give the command either with -c or after the options, not both." << std::endl;
+        dead(1);
+    }
+
+    if (!commands.empty()) {
+        command = commands.front();
+    } else if (!command.empty()) {
+        commands.push_back(command);
+    }
+
+    if ((!parameters.empty() || commands.size() > 1) && (!scaleLevels.empty() || !cpuSweep.empty())) {
+        std::cerr << "Error: -P and multiple commands cannot be combined with --scale or --cpus-sweep." << std::endl;
+        dead(1);
+    }
+
+    bool baseline = !saveBaselineName.empty() || !compareBaselineName.empty();
+    if (baseline && (!parameters.empty() || commands.size() > 1 || !scaleLevels.empty() || !cpuSweep.empty())) {
+        std::cerr << "Error: Baselines are kept for a single benchmark, not with -P, several commands or sweeps." << std::endl;
+        dead(1);
     }
 
-    if (command.empty()) {
+    // Calibration alone is a valid invocation
+    if (command.empty() && !calibrateHarness) {
         std::cerr << "Error: No command specified. Use --help for usage." << std::endl;
         dead(1);
     }
@@ -3,11 +3,61 @@
 
 #include <string>
 #include <vector>
+#include "counters.h"
+#include "spawn.h"
+
+// A named parameter of the benchmark matrix and the values it takes
+struct Parameter {
+    std::string name;
+    std::vector<std::string> values;
+};
+
+// Order in which the runs of several benchmarks are scheduled
+enum class Order {
+    Blocked,     // All runs of one benchmark before the next
+    Interleaved, // One run of every benchmark per round
+    Shuffle      // Every round in a fresh random order
+};
+
+// Format of the per-run records
+enum class Format {
+    Text,    // No records, only the report
+    Json,
+    Csv,
+    Markdown
+};
 
 extern double duration;
+extern double gracePeriod;
+extern long long maxMemory;
+extern double maxCpuTime;
+extern double memoryInterval;
+extern int runs;
+extern int jobs;
+extern std::vector<int> scaleLevels;
+extern std::vector<int> cpuSweep;
+extern int warmup;
+extern double precision;
+extern int maxRuns;
+extern double maxTime;
 extern std::string outStream;
+extern Format outputFormat;
 extern bool verbose;
+extern bool calibrateHarness;
+extern bool useCgroup;
+extern bool subtractOverhead;
+extern bool excludeOutliers;
+extern std::string saveBaselineName;
+extern std::string compareBaselineName;
+extern double regressionThreshold;
+extern std::string historyPath;
+extern SpawnMethod spawnMethod;
+extern std::vector<CounterSpec> counters;
 extern std::vector<std::string> command;
+extern std::vector<std::vector<std::string>> commands;
+extern std::vector<Parameter> parameters;
+extern Order runOrder;
+extern unsigned long seed;
 
 // Function to handle command line arguments
 void handleArguments(int argc, char** argv);
@@ -0,0 +1,208 @@
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <sys/stat.h>
+
+#include "baseline.h"
+#include "timez.h"
+
+// One compared metric, with its samples in the unit format expects
+struct Metric {
+    std::string name;
+    std::string label;
+    std::string (*format)(double);
+    std::vector<double> samples;
+};
+
+static std::string formatKilobytes(double kilobytes) {
+    return formatMemory(std::lround(kilobytes));
+}
+
+static double toMicroseconds(const struct timeval& tv) {
+    return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+// The metrics of the runs of benchmark
+static std::vector<Metric> currentMetrics(const Benchmark& benchmark) {
+    std::vector<Metric> metrics = {
+        {"wall", "Runtime", formatDuration, {}},
+        {"user", "User time", formatDuration, {}},
+        {"system", "System time", formatDuration, {}},
+        {"maxrss", "Memory used", formatKilobytes, {}}
+    };
+
+    for (const auto& run : benchmark.results) {
+        metrics[0].samples.push_back(run.runtime.count());
+        metrics[1].samples.push_back(toMicroseconds(run.usage.ru_utime));
+        metrics[2].samples.push_back(toMicroseconds(run.usage.ru_stime));
+        metrics[3].samples.push_back(run.usage.ru_maxrss);
+    }
+
+    return metrics;
+}
+
+// The baseline loaded by loadBaseline for compareBaseline
+static std::vector<Metric> savedMetrics;
+static std::string savedCommand;
+
+// Baselines live in .timez/baselines of the working directory, so they can
+// be kept next to the code they measure; the directory is only created
+// when a baseline is saved
+static std::string baselinePath(const std::string& name, bool create) {
+    if (name.find('/') != std::string::npos) {
+        return name;
+    }
+
+    for (const char* directory : {".timez", ".timez/baselines"}) {
+        if (create && mkdir(directory, 0755) == -1 && errno != EEXIST) {
+            std::cerr << "Error: Cannot create " << directory << "." << std::endl;
+            dead(1);
+        }
+    }
+
+    return ".timez/baselines/" + name;
+}
+
+static std::string commandLine(const std::vector<std::string>& command) {
+    std::string line;
+
+    for (const auto& word : command) {
+        line += (line.empty() ? "" : " ") + word;
+    }
+
+    return line;
+}
+
+void saveBaseline(const std::string& name, const Benchmark& benchmark) {
+    std::string path = baselinePath(name, true);
+    std::string temporary = path + ".tmp";
+
+    std::ofstream file(temporary);
+    file << std::setprecision(17);
+    file << "timez-baseline 1" << std::endl;
+    file << "command " << commandLine(benchmark.command) << std::endl;
+
+    for (const auto& metric : currentMetrics(benchmark)) {
+        file << metric.name;
+        for (double sample : metric.samples) {
+            file << " " << sample;
+        }
+        file << std::endl;
+    }
+
+    file.close();
+
+    // Written aside and renamed so a failed run never leaves half a baseline
+    if (!file || std::rename(temporary.c_str(), path.c_str()) == -1) {
+        std::cerr << "Error: Cannot write baseline " << path << "." << std::endl;
+        dead(1);
+    }
+}
+
+// Read the samples of every metric of a baseline by name
+static void readBaseline(const std::string& path, std::vector<Metric>& metrics, std::string& line) {
+    std::ifstream file(path);
+    std::string header;
+
+    if (!file.is_open()) {
+        std::cerr << "Error: No baseline at " << path << ", create it with --save-baseline." << std::endl;
+        dead(1);
+    }
+
+    if (!std::getline(file, header) || header != "timez-baseline 1") {
+        std::cerr << "Error: " << path << " is not a timez baseline." << std::endl;
+        dead(1);
+    }
+
+    std::string text;
+    while (std::getline(file, text)) {
+        std::istringstream fields(text);
+        std::string key;
+        fields >> key;
+
+        if (key == "command") {
+            std::getline(fields >> std::ws, line);
+            continue;
+        }
+
+        for (auto& metric : metrics) {
+            if (metric.name == key) {
+                double sample;
+                while (fields >> sample) {
+                    metric.samples.push_back(sample);
+                }
+            }
+        }
+    }
+}
+
+void loadBaseline(const std::string& name) {
+    savedMetrics = currentMetrics(Benchmark());
+    readBaseline(baselinePath(name, false), savedMetrics, savedCommand);
+}
+
+bool compareBaseline(const std::string& name, const Benchmark& benchmark) {
+    std::vector<Metric> current = currentMetrics(benchmark);
+    const std::vector<Metric>& saved = savedMetrics;
+
+    if (savedCommand != commandLine(benchmark.command)) {
+        std::cerr << "Warning: The baseline was measured for '" << savedCommand << "'." << std::endl;
+    }
+
+    *outputStream << "Compared with baseline " << name << ", tolerating "
+                  << regressionThreshold * 100 << "%:" << std::endl;
+
+    bool regressed = false;
+    bool untested = false;
+
+    for (size_t i = 0; i < current.size(); i++) {
+        Summary before = summarize(saved[i].samples);
+        Summary after = summarize(current[i].samples);
+
+        if (before.count == 0 || after.count == 0) {
+            printRow(current[i].label, "<not in baseline>");
+            continue;
+        }
+
+        std::ostringstream row;
+        row << current[i].format(before.mean) << " -> " << current[i].format(after.mean);
+
+        // A metric that was zero before has no relative change
+        double change = before.mean > 0.0 ? after.mean / before.mean - 1 : 0.0;
+        row << std::fixed << std::setprecision(1) << " (" << (change >= 0 ? "+" : "") << change * 100 << "%";
+
+        // The slowdown has to be beyond the threshold and unlikely to be
+        // noise, which a single run on either side cannot show
+        bool testable = before.count > 1 && after.count > 1;
+        bool significant = false;
+        if (testable) {
+            double p = mannWhitneyU(current[i].samples, saved[i].samples);
+            row << ", p = " << std::setprecision(4) << p;
+            significant = p < 0.05;
+        }
+        row << ")";
+
+        if (change > regressionThreshold && significant) {
+            row << " REGRESSION";
+            regressed = true;
+        } else if (change > regressionThreshold && !testable) {
+            row << " slower, not tested";
+            untested = true;
+        }
+
+        printRow(current[i].label, row.str());
+    }
+
+    *outputStream << std::endl;
+
+    if (untested) {
+        std::cerr << "Warning: The baseline or this benchmark has a single run, slowdowns cannot fail the"
+                  << " comparison. Use --runs 2 or more on both sides." << std::endl;
+    }
+
+    return regressed;
+}
@@ -0,0 +1,23 @@
+#ifndef BASELINE_H
+#define BASELINE_H
+
+#include <string>
+#include "timez.h"
+
+// Exit status when a metric regressed against the baseline
+const int regressionExitCode = 2;
+
+// Function to save the runs of benchmark as the named baseline, a name
+// with a '/' is taken as the path of the file
+void saveBaseline(const std::string& name, const Benchmark& benchmark);
+
+// Function to read the named baseline for compareBaseline, done before the
+// benchmark runs so a missing or invalid baseline fails right away
+void loadBaseline(const std::string& name);
+
+// Function to compare the runs of benchmark with the baseline loaded by
+// loadBaseline under name, print every metric side by side and return
+// whether any of them regressed
+bool compareBaseline(const std::string& name, const Benchmark& benchmark);
+
+#endif // BASELINE_H
@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "cgroup.h"
+#include "utils.h"
+
+static std::string basePath;
+static std::string leafPath;
+static std::vector<std::string> enabledControllers;
+static int runCount = 0;
+
+static bool writeFile(const std::string& path, const std::string& value) {
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    bool ok = write(fd, value.c_str(), value.size()) == static_cast<ssize_t>(value.size());
+    int error = errno;
+    close(fd);
+    errno = error;
+
+    return ok;
+}
+
+static std::string readFile(const std::string& path) {
+    std::ifstream in(path);
+    std::stringstream content;
+    content << in.rdbuf();
+    return content.str();
+}
+
+// Mount point of the unified hierarchy, also found on hybrid systems
+static std::string findCgroup2Mount() {
+    std::ifstream mountinfo("/proc/self/mountinfo");
+    std::string line;
+
+    while (std::getline(mountinfo, line)) {
+        size_t separator = line.find(" - ");
+        if (separator == std::string::npos || line.compare(separator + 3, 8, "cgroup2 ") != 0) {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        std::string id, parent, device, root, mountPoint;
+        fields >> id >> parent >> device >> root >> mountPoint;
+        return mountPoint;
+    }
+
+    return "";
+}
+
+static std::string findOwnCgroup() {
+    std::ifstream cgroups("/proc/self/cgroup");
+    std::string line;
+
+    while (std::getline(cgroups, line)) {
+        if (line.compare(0, 3, "0::") == 0) {
+            return line.substr(3);
+        }
+    }
+
+    return "";
+}
+
+// Leaf cgroup for timez itself, a cgroup with processes cannot hand out
+// controllers to its children
+static bool moveSelfToLeaf() {
+    leafPath = basePath + "/timez-" + std::to_string(getpid());
+
+    if (mkdir(leafPath.c_str(), 0755) < 0 && errno != EEXIST) {
+        leafPath.clear();
+        return false;
+    }
+
+    return writeFile(leafPath + "/cgroup.procs", "0");
+}
+
+void setupCgroups() {
+    std::string mount = findCgroup2Mount();
+    std::string own = findOwnCgroup();
+
+    if (mount.empty() || own.empty()) {
+        std::cerr << "Error: --cgroup needs a cgroup v2 hierarchy." << std::endl;
+        dead(1);
+    }
+
+    basePath = mount + (own == "/" ? "" : own);
+
+    if (access((basePath + "/cgroup.procs").c_str(), W_OK) < 0) {
+        std::cerr << "Error: cgroup " << basePath << " is not delegated to us." << std::endl;
+        dead(1);
+    }
+
+    // Controllers that are already on are left as they are, at exit we only
+    // turn off those we turned on, which siblings may use as well
+    std::istringstream active(readFile(basePath + "/cgroup.subtree_control"));
+    std::vector<std::string> alreadyEnabled;
+    std::string controller;
+
+    while (active >> controller) {
+        alreadyEnabled.push_back(controller);
+    }
+
+    std::istringstream available(readFile(basePath + "/cgroup.controllers"));
+
+    while (available >> controller) {
+        if (controller != "cpu" && controller != "memory" && controller != "io" && controller != "pids") {
+            continue;
+        }
+
+        if (std::find(alreadyEnabled.begin(), alreadyEnabled.end(), controller) != alreadyEnabled.end()) {
+            continue;
+        }
+
+        bool enabled = writeFile(basePath + "/cgroup.subtree_control", "+" + controller);
+
+        if (!enabled && errno == EBUSY && leafPath.empty() && moveSelfToLeaf()) {
+            enabled = writeFile(basePath + "/cgroup.subtree_control", "+" + controller);
+        }
+
+        if (enabled) {
+            enabledControllers.push_back(controller);
+        } else {
+            std::cerr << "Warning: Cannot enable the " << controller
+                      << " controller, its statistics will be missing." << std::endl;
+        }
+    }
+}
+
+ChildSetup createRunCgroup() {
+    ChildSetup setup;
+    std::string runPath = basePath + "/timez-" + std::to_string(getpid()) + "-run-" + std::to_string(++runCount);
+
+    if (mkdir(runPath.c_str(), 0755) < 0) {
+        std::cerr << "Failed to create cgroup " << runPath << ": " << strerror(errno) << std::endl;
+        dead(1);
+    }
+
+    setup.cgroupDir = open(runPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    setup.cgroupProcs = open((runPath + "/cgroup.procs").c_str(), O_WRONLY | O_CLOEXEC);
+
+    if (setup.cgroupDir < 0 || setup.cgroupProcs < 0) {
+        std::cerr << "Failed to open cgroup " << runPath << ": " << strerror(errno) << std::endl;
+        dead(1);
+    }
+
+    setup.cgroupPath = runPath;
+    return setup;
+}
+
+// Every run has its own cgroup, concurrent instances must not share a path
+bool limitRunCgroupMemory(const ChildSetup& setup, long long bytes) {
+    const std::string& runPath = setup.cgroupPath;
+
+    if (!writeFile(runPath + "/memory.max", std::to_string(bytes))) {
+        return false;
+    }
+
+    // Without this the limit could be dodged by swapping out
+    writeFile(runPath + "/memory.swap.max", "0");
+    return true;
+}
+
+// Value following key in a "key value" or "key=value" file, or -1
+static double statField(const std::string& content, const std::string& key) {
+    size_t pos = content.find(key);
+    return pos == std::string::npos ? -1 : std::atof(content.c_str() + pos + key.size());
+}
+
+static long readNumber(const std::string& path) {
+    std::string content = readFile(path);
+    return content.empty() ? -1 : std::atol(content.c_str());
+}
+
+CgroupStats collectRunCgroup(ChildSetup& setup) {
+    CgroupStats stats;
+    const std::string runPath = setup.cgroupPath;
+
+    // cpu.stat has the basic times even without the cpu controller
+    std::string cpu = readFile(runPath + "/cpu.stat");
+    stats.cpuUsage = statField(cpu, "usage_usec ");
+    stats.cpuUser = statField(cpu, "user_usec ");
+    stats.cpuSystem = statField(cpu, "system_usec ");
+
+    long peak = readNumber(runPath + "/memory.peak");
+    stats.memoryPeak = peak < 0 ? -1 : peak / 1024;
+
+    // io.stat has one line per device
+    if (access((runPath + "/io.stat").c_str(), R_OK) == 0) {
+        std::istringstream io(readFile(runPath + "/io.stat"));
+        std::string token;
+        stats.ioReadBytes = stats.ioWriteBytes = stats.ioReads = stats.ioWrites = 0;
+
+        while (io >> token) {
+            if (token.compare(0, 7, "rbytes=") == 0) {
+                stats.ioReadBytes += std::atol(token.c_str() + 7);
+            } else if (token.compare(0, 7, "wbytes=") == 0) {
+                stats.ioWriteBytes += std::atol(token.c_str() + 7);
+            } else if (token.compare(0, 5, "rios=") == 0) {
+                stats.ioReads += std::atol(token.c_str() + 5);
+            } else if (token.compare(0, 5, "wios=") == 0) {
+                stats.ioWrites += std::atol(token.c_str() + 5);
+            }
+        }
+    }
+
+    stats.processes = readNumber(runPath + "/pids.peak");
+
+    if (access((runPath + "/memory.events").c_str(), R_OK) == 0) {
+        stats.oomKills = statField(readFile(runPath + "/memory.events"), "oom_kill ");
+    }
+
+    close(setup.cgroupProcs);
+    close(setup.cgroupDir);
+    setup.cgroupProcs = -1;
+    setup.cgroupDir = -1;
+    setup.cgroupPath.clear();
+
+    rmdir(runPath.c_str());
+    return stats;
+}
+
+void cleanupCgroups() {
+    if (basePath.empty()) {
+        return;
+    }
+
+    // Hand back the controllers we enabled so we can return to where we started
+    for (const auto& controller : enabledControllers) {
+        writeFile(basePath + "/cgroup.subtree_control", "-" + controller);
+    }
+
+    if (!leafPath.empty()) {
+        writeFile(basePath + "/cgroup.procs", "0");
+        rmdir(leafPath.c_str());
+    }
+
+    basePath.clear();
+}
@@ -0,0 +1,38 @@
+#ifndef CGROUP_H
+#define CGROUP_H
+
+#include <string>
+#include "spawn.h"
+
+// Totals of the whole process tree of one run, read from its cgroup,
+// values that the cgroup does not provide are negative
+struct CgroupStats {
+    double cpuUsage = -1;  // Microseconds
+    double cpuUser = -1;   // Microseconds
+    double cpuSystem = -1; // Microseconds
+    long memoryPeak = -1;  // Kilobytes
+    long ioReadBytes = -1;
+    long ioWriteBytes = -1;
+    long ioReads = -1;
+    long ioWrites = -1;
+    long processes = -1;   // Peak number of processes
+    long oomKills = -1;    // Processes killed for exceeding memory.max
+};
+
+// Function to find our delegated cgroup and enable controllers for the runs
+void setupCgroups();
+
+// Function to create a fresh cgroup for the next run
+ChildSetup createRunCgroup();
+
+// Function to limit the memory of the run cgroup of setup, returns false
+// when the memory controller is not available
+bool limitRunCgroupMemory(const ChildSetup& setup, long long bytes);
+
+// Function to read the statistics of the run cgroup of setup and remove it
+CgroupStats collectRunCgroup(ChildSetup& setup);
+
+// Function to undo the changes made by setupCgroups
+void cleanupCgroups();
+
+#endif // CGROUP_H
@@ -0,0 +1,132 @@
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <unistd.h>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+#include "counters.h"
+
+static const CounterSpec knownCounters[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, false},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, false},
+    {"cache-references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES, false},
+    {"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, false},
+    {"branches", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS, false},
+    {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, false},
+    {"bus-cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BUS_CYCLES, false},
+    {"stalled-cycles-frontend", PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND, false},
+    {"stalled-cycles-backend", PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND, false},
+    {"ref-cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_REF_CPU_CYCLES, false},
+    {"task-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, false},
+    {"page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, false},
+    {"context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, false},
+    {"cpu-migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS, false},
+};
+
+bool parseCounters(const std::string& list, std::vector<CounterSpec>& counters) {
+    std::istringstream in(list);
+    std::string name;
+
+    while (std::getline(in, name, ',')) {
+        bool found = false;
+
+        for (const auto& known : knownCounters) {
+            if (known.name == name) {
+                counters.push_back(known);
+                found = true;
+                break;
+            }
+        }
+
+        if (!found) {
+            return false;
+        }
+    }
+
+    // A miss rate needs the events the misses are a share of
+    static const char* denominators[][2] = {
+        {"cache-misses", "cache-references"},
+        {"branch-misses", "branches"},
+    };
+
+    for (const auto& pair : denominators) {
+        bool wanted = false, present = false;
+
+        for (const auto& counter : counters) {
+            wanted = wanted || counter.name == pair[0];
+            present = present || counter.name == pair[1];
+        }
+
+        if (wanted && !present) {
+            for (const auto& known : knownCounters) {
+                if (known.name == pair[1]) {
+                    counters.push_back(known);
+                    counters.back().hidden = true;
+                }
+            }
+        }
+    }
+
+    return !counters.empty();
+}
+
+std::vector<int> openCounters(const std::vector<CounterSpec>& counters) {
+    std::vector<int> fds;
+
+    for (const auto& counter : counters) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counter.type;
+        attr.config = counter.config;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // The counter is opened on ourselves but stays disabled, children
+        // inherit a copy that is enabled by their exec and whose counts
+        // are folded back into this one when they exit
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.enable_on_exec = 1;
+
+        int fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+
+        // Unprivileged users may only be allowed to count user space
+        if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        }
+
+        fds.push_back(fd);
+    }
+
+    return fds;
+}
+
+std::vector<double> readCounters(std::vector<int>& fds) {
+    std::vector<double> values;
+
+    for (int fd : fds) {
+        uint64_t data[3];
+
+        if (fd < 0 || read(fd, data, sizeof(data)) != sizeof(data)) {
+            values.push_back(NAN);
+        } else if (data[2] == 0) {
+            // The counter never got scheduled on the PMU
+            values.push_back(0.0);
+        } else {
+            // Scale up when the counter was multiplexed with others
+            values.push_back(static_cast<double>(data[0]) * data[1] / data[2]);
+        }
+
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    fds.clear();
+    return values;
+}
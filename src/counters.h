@@ -0,0 +1,28 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A hardware or software event that can be counted for the command
+struct CounterSpec {
+    std::string name;
+    uint32_t type;
+    uint64_t config;
+    bool hidden; // Only opened as the denominator of a miss rate
+};
+
+// Function to parse a comma separated list of counter names, adding the
+// denominators of requested miss counters as hidden counters
+bool parseCounters(const std::string& list, std::vector<CounterSpec>& counters);
+
+// Function to open the counters so the next launched child inherits them,
+// they start counting when the child calls exec
+std::vector<int> openCounters(const std::vector<CounterSpec>& counters);
+
+// Function to read and close the counters once the child has been reaped,
+// counters that could not be opened read as NaN
+std::vector<double> readCounters(std::vector<int>& fds);
+
+#endif // COUNTERS_H
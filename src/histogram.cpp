@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <string>
+
+#include "histogram.h"
+
+// Exact buckets below linearLimit, subBuckets per power of two above it
+static const unsigned long long linearLimit = 256;
+static const unsigned long long subBuckets = 128;
+static const size_t bucketCount = linearLimit + (64 - 8) * subBuckets;
+
+static size_t bucketIndex(unsigned long long value) {
+    if (value < linearLimit) {
+        return value;
+    }
+
+    // The top eight bits select the bucket within the power of two
+    int shift = 63 - __builtin_clzll(value) - 7;
+    unsigned long long top = value >> shift;
+    return linearLimit + (shift - 1) * subBuckets + (top - subBuckets);
+}
+
+// Smallest and largest value that fall into a bucket
+static void bucketRange(size_t index, unsigned long long& low, unsigned long long& high) {
+    if (index < linearLimit) {
+        low = high = index;
+        return;
+    }
+
+    int shift = (index - linearLimit) / subBuckets + 1;
+    unsigned long long top = (index - linearLimit) % subBuckets + subBuckets;
+    low = top << shift;
+    high = ((top + 1) << shift) - 1;
+}
+
+void recordValue(Histogram& histogram, double value) {
+    if (histogram.counts.empty()) {
+        histogram.counts.assign(bucketCount, 0);
+    }
+
+    unsigned long long rounded = std::llround(std::max(value, 0.0));
+
+    histogram.counts[bucketIndex(rounded)]++;
+    histogram.min = histogram.total == 0 ? rounded : std::min(histogram.min, rounded);
+    histogram.max = std::max(histogram.max, rounded);
+    histogram.total++;
+}
+
+void mergeHistogram(Histogram& into, const Histogram& from) {
+    if (from.total == 0) {
+        return;
+    }
+
+    if (into.counts.empty()) {
+        into.counts.assign(bucketCount, 0);
+    }
+
+    for (size_t i = 0; i < bucketCount; i++) {
+        into.counts[i] += from.counts[i];
+    }
+
+    into.min = into.total == 0 ? from.min : std::min(into.min, from.min);
+    into.max = std::max(into.max, from.max);
+    into.total += from.total;
+}
+
+double valueAtPercentile(const Histogram& histogram, double percentile) {
+    if (histogram.total == 0) {
+        return 0.0;
+    }
+
+    // Nearest rank, as the smallest value with at least that many values at or below it
+    unsigned long long rank = std::max(1.0, std::ceil(percentile / 100 * histogram.total));
+    unsigned long long seen = 0;
+
+    for (size_t i = 0; i < bucketCount; i++) {
+        seen += histogram.counts[i];
+
+        if (seen >= rank) {
+            unsigned long long low, high;
+            bucketRange(i, low, high);
+
+            // The middle of the bucket, kept within the values actually seen
+            double value = (low + high) / 2.0;
+            return std::min(std::max(value, double(histogram.min)), double(histogram.max));
+        }
+    }
+
+    return histogram.max;
+}
+
+void printHistogram(std::ostream& out, const Histogram& histogram, size_t rows,
+                    std::string (*format)(double)) {
+    if (histogram.total == 0 || rows == 0) {
+        return;
+    }
+
+    double width = double(histogram.max - histogram.min + 1) / rows;
+    std::vector<unsigned long long> bins(rows, 0);
+
+    // Buckets are assigned to rows by their middle value
+    for (size_t i = 0; i < bucketCount; i++) {
+        if (histogram.counts[i] == 0) {
+            continue;
+        }
+
+        unsigned long long low, high;
+        bucketRange(i, low, high);
+        double middle = std::min(std::max((low + high) / 2.0, double(histogram.min)), double(histogram.max));
+
+        size_t row = std::min(rows - 1, size_t((middle - histogram.min) / width));
+        bins[row] += histogram.counts[i];
+    }
+
+    unsigned long long highest = *std::max_element(bins.begin(), bins.end());
+    const size_t barWidth = 40;
+
+    for (size_t row = 0; row < rows; row++) {
+        size_t bar = std::lround(double(bins[row]) / highest * barWidth);
+        std::string label = format(histogram.min + row * width);
+
+        out << std::right << std::setw(12) << label << " | " << std::string(bar, '#')
+            << std::string(barWidth - bar, ' ') << " " << bins[row] << std::endl;
+    }
+    out << std::left;
+}
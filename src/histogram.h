@@ -0,0 +1,34 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Log-linear histogram in the style of HdrHistogram: values below 256 get
+// a bucket each, above that every power of two is split into 128 buckets,
+// so any value is kept to within 0.8% in a fixed 58 KB
+struct Histogram {
+    std::vector<unsigned long long> counts; // Allocated on the first value
+    unsigned long long total = 0;
+    unsigned long long min = 0;
+    unsigned long long max = 0;
+};
+
+// Function to add a non-negative value to the histogram
+void recordValue(Histogram& histogram, double value);
+
+// Function to add all values of from into into, e.g. to combine the
+// histograms of repeated or concurrent runs
+void mergeHistogram(Histogram& into, const Histogram& from);
+
+// Function to return the value below which the given percentage of the
+// values fall, 0 for an empty histogram
+double valueAtPercentile(const Histogram& histogram, double percentile);
+
+// Function to draw the histogram as rows of bars over evenly sized ranges
+// of values, formatting the ranges with format
+void printHistogram(std::ostream& out, const Histogram& histogram, size_t rows,
+                    std::string (*format)(double));
+
+#endif // HISTOGRAM_H
@@ -1,18 +1,77 @@
+#include "baseline.h"
+#include "matrix.h"
+#include "output.h"
+#include "report.h"
+#include "store.h"
+#include "sweep.h"
 #include "timez.h"
 
 int main(int argc, char** argv) {
+    // `timez -- report` still runs a command named report
+    if (argc > 1 && std::string(argv[1]) == "report") {
+        return runReport(argc - 1, argv + 1);
+    }
+
     handleArguments(argc, argv);
+    openOutput();
+
+    bool regressed = false;
+
+    if (calibrateHarness) {
+        calibrate();
+        printCalibration();
+    }
+
+    if (!command.empty()) {
+        if (useCgroup) {
+            setupCgroups();
+        }
+
+        if (!cpuSweep.empty()) {
+            runCpuSweep();
+            printCpuSweepReport();
+
+            cleanup();
+            return 0;
+        }
+
+        if (!scaleLevels.empty()) {
+            runScalingSweep();
+            printScalingReport();
+
+            cleanup();
+            return 0;
+        }
+
+        if (!parameters.empty() || commands.size() > 1) {
+            runBenchmarks();
+            printBenchmarks();
+            printComparison();
+
+            cleanup();
+            return 0;
+        }
+
+        if (!compareBaselineName.empty()) {
+            loadBaseline(compareBaselineName);
+        }
 
-    executeCommand();
+        Benchmark benchmark = newBenchmark(command);
 
-    measureResources();
+        runBenchmark(benchmark);
+        appendHistory(benchmark);
+        printReport(benchmark);
 
-    printResourceUsage();
+        // Compared before saving, so one name can gate and then advance
+        if (!compareBaselineName.empty()) {
+            regressed = compareBaseline(compareBaselineName, benchmark);
+        }
 
-    if (verbose) {
-        printExtraInfo();
+        if (!saveBaselineName.empty()) {
+            saveBaseline(saveBaselineName, benchmark);
+        }
     }
 
     cleanup();
-    return 0;
+    return regressed ? regressionExitCode : 0;
 }
@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#include "matrix.h"
+#include "store.h"
+
+std::vector<Benchmark> benchmarks;
+
+// Replace every {name} in arg by value
+static std::string substitute(std::string arg, const std::string& name, const std::string& value) {
+    std::string placeholder = "{" + name + "}";
+
+    for (size_t at = arg.find(placeholder); at != std::string::npos;
+         at = arg.find(placeholder, at + value.size())) {
+        arg.replace(at, placeholder.size(), value);
+    }
+
+    return arg;
+}
+
+// Join the words of a command back into a single line for labels
+static std::string joinCommand(const std::vector<std::string>& words) {
+    std::string line;
+
+    for (const auto& word : words) {
+        if (!line.empty()) {
+            line += " ";
+        }
+        line += word;
+    }
+
+    return line;
+}
+
+// The names of every {name} in arg
+static std::vector<std::string> findPlaceholders(const std::string& arg) {
+    std::vector<std::string> names;
+
+    for (size_t open = arg.find('{'); open != std::string::npos; open = arg.find('{', open + 1)) {
+        size_t end = open + 1;
+        while (end < arg.size() && (std::isalnum((unsigned char)arg[end]) || arg[end] == '_')) {
+            end++;
+        }
+
+        if (end > open + 1 && end < arg.size() && arg[end] == '}') {
+            names.push_back(arg.substr(open + 1, end - open - 1));
+        }
+    }
+
+    return names;
+}
+
+// Edit distance between a and b, ignoring case
+static size_t distance(const std::string& a, const std::string& b) {
+    std::vector<size_t> row(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); j++) {
+        row[j] = j;
+    }
+
+    for (size_t i = 1; i <= a.size(); i++) {
+        size_t diagonal = row[0];
+        row[0] = i;
+
+        for (size_t j = 1; j <= b.size(); j++) {
+            size_t above = row[j];
+            bool same = std::tolower((unsigned char)a[i - 1]) == std::tolower((unsigned char)b[j - 1]);
+            row[j] = std::min({row[j] + 1, row[j - 1] + 1, diagonal + (same ? 0 : 1)});
+            diagonal = above;
+        }
+    }
+
+    return row[b.size()];
+}
+
+// Warn about a {name} that looks like a misspelt parameter. Braces are
+// common in shell and awk, so anything not close to a parameter name is
+// left alone and passed on as is
+static void checkPlaceholders() {
+    std::vector<std::string> warned;
+
+    for (const auto& words : commands) {
+        for (const auto& word : words) {
+            for (const auto& name : findPlaceholders(word)) {
+                for (const auto& parameter : parameters) {
+                    if (name == parameter.name || distance(name, parameter.name) > parameter.name.size() / 3
+                        || std::find(warned.begin(), warned.end(), name) != warned.end()) {
+                        continue;
+                    }
+
+                    std::cerr << "Warning: {" << name << "} in the command is not a parameter, did you mean {"
+                              << parameter.name << "}?" << std::endl;
+                    warned.push_back(name);
+                }
+            }
+        }
+    }
+}
+
+void buildBenchmarks() {
+    benchmarks.clear();
+
+    // A parameter no command refers to would only repeat the same benchmark
+    for (const auto& parameter : parameters) {
+        bool used = false;
+
+        for (const auto& words : commands) {
+            for (const auto& word : words) {
+                used = used || word.find("{" + parameter.name + "}") != std::string::npos;
+            }
+        }
+
+        if (!used) {
+            std::cerr << "Error: Parameter " << parameter.name << " is not used as {"
+                      << parameter.name << "} in the command." << std::endl;
+            dead(1);
+        }
+    }
+
+    checkPlaceholders();
+
+    // Commands are only named in the label when there is more than one
+    for (const auto& words : commands) {
+        Benchmark base = newBenchmark(words);
+        if (commands.size() > 1) {
+            base.label = joinCommand(words);
+        }
+        benchmarks.push_back(base);
+    }
+
+    // The first parameter varies slowest, so results group by it
+    for (const auto& parameter : parameters) {
+        std::vector<Benchmark> expanded;
+
+        for (const auto& benchmark : benchmarks) {
+            for (const auto& value : parameter.values) {
+                Benchmark next = benchmark;
+
+                if (!next.label.empty()) {
+                    next.label += ", ";
+                }
+                next.label += parameter.name + "=" + value;
+
+                if (!next.values.empty()) {
+                    next.values += ", ";
+                }
+                next.values += parameter.name + "=" + value;
+
+                for (auto& arg : next.command) {
+                    arg = substitute(arg, parameter.name, value);
+                }
+
+                expanded.push_back(next);
+            }
+        }
+
+        benchmarks.swap(expanded);
+    }
+}
+
+static void runBlocked() {
+    for (auto& benchmark : benchmarks) {
+        if (verbose) {
+            *verboseStream << "Running with " << benchmark.label << std::endl;
+        }
+
+        runBenchmark(benchmark);
+    }
+}
+
+// Run one round of every benchmark at a time, so drift over the session
+// such as thermal throttling or background jobs hits all of them alike
+static void runRounds() {
+    std::mt19937 generator(seed);
+    std::vector<size_t> order(benchmarks.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+
+    for (auto& benchmark : benchmarks) {
+        runWarmup(benchmark);
+    }
+
+    auto started = std::chrono::steady_clock::now();
+
+    for (int round = 1;; round++) {
+        if (runOrder == Order::Shuffle) {
+            std::shuffle(order.begin(), order.end(), generator);
+        }
+
+        bool reached = true;
+        for (size_t i : order) {
+            runRound(benchmarks[i]);
+            reached = reached && precision > 0.0 && precisionReached(benchmarks[i]);
+        }
+
+        if (precision <= 0.0) {
+            if (round >= runs) {
+                return;
+            }
+            continue;
+        }
+
+        if (reached) {
+            return;
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        if (precisionExhausted(benchmarks.front().results.size(), elapsed.count())) {
+            break;
+        }
+    }
+
+    std::cerr << "Warning: precision target not reached after " << benchmarks.front().results.size()
+              << " runs of each benchmark." << std::endl;
+}
+
+void runBenchmarks() {
+    buildBenchmarks();
+
+    if (runOrder == Order::Blocked) {
+        runBlocked();
+    } else {
+        runRounds();
+    }
+
+    for (const auto& benchmark : benchmarks) {
+        appendHistory(benchmark);
+    }
+}
+
+void printBenchmarks() {
+    for (auto& benchmark : benchmarks) {
+        *outputStream << std::endl << "Benchmark: " << benchmark.label << std::endl;
+
+        // Outliers dropped by the report are gone from the comparison as well
+        printReport(benchmark);
+    }
+}
+
+static std::vector<double> wallTimes(const Benchmark& benchmark) {
+    std::vector<double> wall;
+
+    for (const auto& run : benchmark.results) {
+        wall.push_back(run.runtime.count());
+    }
+
+    return wall;
+}
+
+void printComparison() {
+    size_t fastest = 0;
+    std::vector<Summary> summaries;
+
+    for (size_t i = 0; i < benchmarks.size(); i++) {
+        summaries.push_back(summarizeMoments(wallTimes(benchmarks[i])));
+
+        if (summaries[i].mean < summaries[fastest].mean) {
+            fastest = i;
+        }
+    }
+
+    const Summary& best = summaries[fastest];
+    std::vector<double> bestWall = wallTimes(benchmarks[fastest]);
+
+    if (runOrder == Order::Shuffle) {
+        *outputStream << std::endl;
+        printRow("Shuffle seed", std::to_string(seed));
+    }
+
+    *outputStream << std::endl << "Relative to the fastest, " << benchmarks[fastest].label << ":" << std::endl;
+
+    for (size_t i = 0; i < benchmarks.size(); i++) {
+        if (i == fastest) {
+            printRow(benchmarks[i].label, "1.00 (fastest)");
+            continue;
+        }
+
+        const Summary& summary = summaries[i];
+
+        // The error of the ratio is propagated from both standard deviations
+        double ratio = summary.mean / best.mean;
+        double error = ratio * std::sqrt(std::pow(summary.stddev / summary.mean, 2) +
+                                         std::pow(best.stddev / best.mean, 2));
+
+        std::ostringstream row;
+        row << std::fixed << std::setprecision(2) << ratio;
+
+        // With a single run on either side there is no spread and nothing to test
+        if (summary.count > 1 && best.count > 1) {
+            double p = mannWhitneyU(wallTimes(benchmarks[i]), bestWall);
+            row << " +/- " << error << " times slower, p = " << std::setprecision(4) << p
+                << (p < 0.05 ? " (significant)" : " (not significant)");
+        } else {
+            row << " times slower";
+        }
+
+        printRow(benchmarks[i].label, row.str());
+    }
+
+    *outputStream << std::endl;
+}
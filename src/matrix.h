@@ -0,0 +1,25 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <string>
+#include <vector>
+#include "timez.h"
+
+// One benchmark for every compared command and combination of -P values
+extern std::vector<Benchmark> benchmarks;
+
+// Function to build the cross product of all commands and -P values,
+// substituting {name} in the command for every parameter
+void buildBenchmarks();
+
+// Function to run the benchmark once for every command and parameter combination
+void runBenchmarks();
+
+// Function to print the report of every parameter combination in turn
+void printBenchmarks();
+
+// Function to print the runtime of every benchmark relative to the fastest,
+// with the p-value of the Mann-Whitney U test against it
+void printComparison();
+
+#endif // MATRIX_H
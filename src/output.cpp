@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+
+#include <sys/wait.h>
+
+#include "output.h"
+
+std::ostream* recordStream = nullptr;
+
+// Swallows the report when the records take over stdout
+static std::ostream nullStream(nullptr);
+static size_t recordCount = 0;
+
+// Column names in record order
+static const char* fields[] = {
+    "command", "jobs", "cpus", "wall_us", "user_us", "system_us",
+    "maxrss_kb", "ixrss_kb", "idrss_kb", "isrss_kb", "minflt", "majflt", "nswap",
+    "inblock", "oublock", "msgsnd", "msgrcv", "nsignals", "nvcsw", "nivcsw",
+    "exit_code", "signal", "termination", "limit"
+};
+
+void openOutput() {
+    std::ostream* sink = &std::cout;
+
+    if (!outStream.empty()) {
+        fileStream.open(outStream);
+
+        if (!fileStream.is_open()) {
+            std::cerr << "Error: Cannot open output file " << outStream << "." << std::endl;
+            dead(1);
+        }
+
+        sink = &fileStream;
+    }
+
+    if (outputFormat == Format::Text) {
+        outputStream = sink;
+        return;
+    }
+
+    // The report moves to stdout next to the records file, and is left out
+    // when the records go to stdout so it stays machine readable
+    recordStream = sink;
+    outputStream = outStream.empty() ? &nullStream : &std::cout;
+
+    // For the same reason the command's own output is thrown away and the
+    // progress of --verbose goes to stderr
+    if (outStream.empty()) {
+        commandOutput = open("/dev/null", O_WRONLY | O_CLOEXEC);
+
+        if (commandOutput < 0) {
+            std::cerr << "Error: Cannot open /dev/null." << std::endl;
+            dead(1);
+        }
+
+        verboseStream = &std::cerr;
+    }
+}
+
+static std::string joinCommand(const std::vector<std::string>& command) {
+    std::string line;
+
+    for (const auto& word : command) {
+        if (!line.empty()) {
+            line += " ";
+        }
+        line += word;
+    }
+
+    return line;
+}
+
+static std::string jsonString(const std::string& text) {
+    std::string quoted = "\"";
+
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        } else {
+            quoted += c;
+        }
+    }
+
+    return quoted + "\"";
+}
+
+static std::string csvString(const std::string& text) {
+    if (text.find_first_of(",\"\n") == std::string::npos) {
+        return text;
+    }
+
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"') {
+            quoted += '"';
+        }
+        quoted += c;
+    }
+
+    return quoted + "\"";
+}
+
+static std::string markdownString(const std::string& text) {
+    std::string escaped;
+
+    for (char c : text) {
+        if (c == '|') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+
+    return "`" + escaped + "`";
+}
+
+static std::string terminationName(Termination termination) {
+    switch (termination) {
+        case Termination::Terminated: return "sigterm";
+        case Termination::Killed: return "sigkill";
+        default: return "on_time";
+    }
+}
+
+static std::string limitName(Limit limit) {
+    switch (limit) {
+        case Limit::Memory: return "memory";
+        case Limit::CpuTime: return "cpu_time";
+        default: return "none";
+    }
+}
+
+static long long microseconds(const struct timeval& tv) {
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static void writeHeader() {
+    std::ostream& out = *recordStream;
+
+    if (outputFormat == Format::Json) {
+        out << "[";
+    } else if (outputFormat == Format::Csv) {
+        for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+            out << (i ? "," : "") << fields[i];
+        }
+        out << "\n";
+    } else {
+        for (const char* field : fields) {
+            out << "| " << field << " ";
+        }
+        out << "|\n";
+        for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+            out << (i ? "| ---: " : "| --- ");
+        }
+        out << "|\n";
+    }
+}
+
+void writeRecord(const Benchmark& benchmark, const RunResult& run) {
+    if (recordStream == nullptr) {
+        return;
+    }
+
+    if (recordCount++ == 0) {
+        writeHeader();
+    }
+
+    const struct rusage& usage = run.usage;
+    bool exited = WIFEXITED(run.status);
+    std::string name = joinCommand(benchmark.command);
+
+    // Every value but the strings, in the order of fields
+    std::vector<long long> numbers = {
+        benchmark.jobs, benchmark.pinnedCpus, run.runtime.count(),
+        microseconds(usage.ru_utime), microseconds(usage.ru_stime),
+        usage.ru_maxrss, usage.ru_ixrss, usage.ru_idrss, usage.ru_isrss,
+        usage.ru_minflt, usage.ru_majflt, usage.ru_nswap,
+        usage.ru_inblock, usage.ru_oublock, usage.ru_msgsnd, usage.ru_msgrcv,
+        usage.ru_nsignals, usage.ru_nvcsw, usage.ru_nivcsw,
+        exited ? WEXITSTATUS(run.status) : -1,
+        WIFSIGNALED(run.status) ? WTERMSIG(run.status) : 0
+    };
+    std::vector<std::string> names = {terminationName(run.termination), limitName(run.limit)};
+
+    std::ostream& out = *recordStream;
+
+    if (outputFormat == Format::Json) {
+        out << (recordCount > 1 ? ",\n  {" : "\n  {") << "\"command\": " << jsonString(name);
+        for (size_t i = 0; i < numbers.size(); i++) {
+            out << ", \"" << fields[i + 1] << "\": " << numbers[i];
+        }
+        for (size_t i = 0; i < names.size(); i++) {
+            out << ", \"" << fields[numbers.size() + 1 + i] << "\": " << jsonString(names[i]);
+        }
+        out << "}";
+    } else if (outputFormat == Format::Csv) {
+        out << csvString(name);
+        for (long long number : numbers) {
+            out << "," << number;
+        }
+        for (const auto& text : names) {
+            out << "," << text;
+        }
+        out << "\n";
+    } else {
+        out << "| " << markdownString(name) << " ";
+        for (long long number : numbers) {
+            out << "| " << number << " ";
+        }
+        for (const auto& text : names) {
+            out << "| " << text << " ";
+        }
+        out << "|\n";
+    }
+
+    out.flush();
+}
+
+void finishRecords() {
+    if (recordStream == nullptr) {
+        return;
+    }
+
+    // An empty set of records still gets its header
+    if (recordCount == 0) {
+        writeHeader();
+    }
+
+    if (outputFormat == Format::Json) {
+        *recordStream << (recordCount > 0 ? "\n]\n" : "]\n");
+    }
+
+    recordStream->flush();
+    recordStream = nullptr;
+}
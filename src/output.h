@@ -0,0 +1,21 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <iostream>
+#include "timez.h"
+
+// Stream the per-run records are written to, if --format asks for them
+extern std::ostream* recordStream;
+
+// Function to open the --out file and point the report and the records
+// at their streams
+void openOutput();
+
+// Function to write one measured run of benchmark as a record, flushed
+// right away so long sweeps never hold them in memory
+void writeRecord(const Benchmark& benchmark, const RunResult& run);
+
+// Function to terminate the records, e.g. close the JSON array
+void finishRecords();
+
+#endif // OUTPUT_H
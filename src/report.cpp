@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+
+#include "cxxopts.hpp"
+#include "report.h"
+#include "store.h"
+
+// What is kept of every matching record
+struct ReportRow {
+    long long timestamp;
+    size_t runs;
+    double wall;   // Median, microseconds
+    double user;   // Mean, microseconds
+    double system; // Mean, microseconds
+    double maxrss; // Maximum, kilobytes
+};
+
+// Records sharing the values of the --group-by fields
+struct ReportGroup {
+    std::string key;
+    std::vector<ReportRow> rows;
+};
+
+// A lasting shift in the median runtime starting at a row
+struct ChangePoint {
+    size_t row;
+    double change;
+    double p;
+};
+
+// Seconds since the epoch of a local YYYY-MM-DD or YYYY-MM-DD HH:MM date,
+// -1 when it is neither
+static long long parseDate(const std::string& text) {
+    struct tm date = {};
+    const char* end = strptime(text.c_str(), "%Y-%m-%d %H:%M", &date);
+
+    if (end == nullptr || *end != '\0') {
+        date = {};
+        end = strptime(text.c_str(), "%Y-%m-%d", &date);
+    }
+
+    if (end == nullptr || *end != '\0') {
+        return -1;
+    }
+
+    date.tm_isdst = -1;
+    return mktime(&date);
+}
+
+static std::string formatDate(long long timestamp) {
+    time_t seconds = timestamp;
+    struct tm date;
+    char text[32];
+
+    localtime_r(&seconds, &date);
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &date);
+    return text;
+}
+
+// Run counts per record are small, these avoid the copies of summarize()
+static double median(std::vector<double>& samples) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+
+    size_t n = samples.size();
+    std::nth_element(samples.begin(), samples.begin() + n / 2, samples.end());
+    double upper = samples[n / 2];
+
+    if (n % 2 == 1) {
+        return upper;
+    }
+
+    return (*std::max_element(samples.begin(), samples.begin() + n / 2) + upper) / 2;
+}
+
+static double mean(const std::vector<double>& samples) {
+    double sum = 0.0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+    return samples.empty() ? 0.0 : sum / samples.size();
+}
+
+// Binary segmentation: split where the two sides have the least squared
+// error around their means, keep the split if the sides differ by more
+// than threshold and the Mann-Whitney U test agrees, and look for more
+// changes on both sides
+static void findChanges(const std::vector<double>& series, size_t begin, size_t end,
+                        double threshold, std::vector<ChangePoint>& changes) {
+    const size_t minimumSegment = 4;
+
+    if (end - begin < 2 * minimumSegment) {
+        return;
+    }
+
+    std::vector<double> sums(1, 0.0), squares(1, 0.0);
+    for (size_t i = begin; i < end; i++) {
+        sums.push_back(sums.back() + series[i]);
+        squares.push_back(squares.back() + series[i] * series[i]);
+    }
+
+    // Squared error of series[begin + from, begin + to) around its mean
+    auto error = [&](size_t from, size_t to) {
+        double sum = sums[to] - sums[from];
+        return squares[to] - squares[from] - sum * sum / (to - from);
+    };
+
+    size_t n = end - begin, best = minimumSegment;
+    for (size_t k = minimumSegment; k <= n - minimumSegment; k++) {
+        if (error(0, k) + error(k, n) < error(0, best) + error(best, n)) {
+            best = k;
+        }
+    }
+
+    size_t split = begin + best;
+    std::vector<double> before(series.begin() + begin, series.begin() + split);
+    std::vector<double> after(series.begin() + split, series.begin() + end);
+
+    double reference = median(before);
+    double change = reference > 0.0 ? median(after) / reference - 1 : 0.0;
+    double p = mannWhitneyU(after, before);
+
+    if (std::fabs(change) <= threshold || p >= 0.05) {
+        return;
+    }
+
+    findChanges(series, begin, split, threshold, changes);
+    changes.push_back({split, change, p});
+    findChanges(series, split, end, threshold, changes);
+}
+
+// Key of a record made of the --group-by fields, built into key to reuse
+// its buffer across records
+static void groupKey(const HistoryRecord& record, const std::vector<std::string>& fields, std::string& key) {
+    key.clear();
+
+    for (const auto& field : fields) {
+        size_t before = key.size();
+
+        if (!key.empty()) {
+            key += " | ";
+        }
+
+        if (field == "command") {
+            key += record.command;
+        } else if (field == "parameters" && !record.parameters.empty()) {
+            key += record.parameters;
+        } else if (field == "host") {
+            key += record.host;
+        } else if (field == "jobs") {
+            key += "jobs=" + std::to_string(record.jobs);
+        } else if (field == "cpus") {
+            key += "cpus=" + std::to_string(record.cpus);
+        } else {
+            // Nothing to add, drop the separator again
+            key.resize(before);
+        }
+    }
+
+    if (key.empty()) {
+        key = "all";
+    }
+}
+
+static void printGroup(const ReportGroup& group, size_t last, double threshold) {
+    std::vector<double> series;
+    for (const auto& row : group.rows) {
+        series.push_back(row.wall);
+    }
+
+    std::vector<ChangePoint> changes;
+    findChanges(series, 0, series.size(), threshold, changes);
+
+    std::cout << std::endl << group.key << std::endl;
+    std::cout << group.rows.size() << " benchmarks, " << changes.size() << " change point(s)" << std::endl;
+
+    // Change points are found over the whole history, only the rows shown are limited
+    size_t first = group.rows.size() > last ? group.rows.size() - last : 0;
+    size_t next = 0;
+
+    for (size_t i = 0; i < group.rows.size(); i++) {
+        while (next < changes.size() && changes[next].row < i) {
+            next++;
+        }
+
+        bool change = next < changes.size() && changes[next].row == i;
+        if (i < first && !change) {
+            continue;
+        }
+
+        const ReportRow& row = group.rows[i];
+        std::ostringstream value;
+
+        value << formatDuration(row.wall) << " median, user " << formatDuration(row.user)
+              << ", system " << formatDuration(row.system) << ", " << formatMemory(std::lround(row.maxrss))
+              << ", " << row.runs << " run(s)";
+
+        if (change) {
+            value << std::fixed << std::setprecision(1) << "  <-- " << (changes[next].change >= 0 ? "+" : "")
+                  << changes[next].change * 100 << "% (p = " << std::setprecision(4) << changes[next].p << ")";
+        }
+
+        printRow(formatDate(row.timestamp), value.str());
+    }
+}
+
+int runReport(int argc, char** argv) {
+    cxxopts::Options options("timez report", "Query the history of benchmarks and find changes in their runtime.");
+
+    options.add_options()
+        ("command", "Only benchmarks whose command contains this text", cxxopts::value<std::string>())
+        ("group-by", "Comma separated fields to group by: command, parameters, host, jobs, cpus",
+         cxxopts::value<std::string>()->default_value("command,parameters,host,jobs,cpus"))
+        ("h,help", "Print help message")
+        ("history", "History file to read, by default in ~/.local/share/timez", cxxopts::value<std::string>())
+        ("host", "Only benchmarks of hosts whose fingerprint contains this text", cxxopts::value<std::string>())
+        ("last", "Number of most recent benchmarks shown per group", cxxopts::value<size_t>()->default_value("20"))
+        ("parameters", "Only benchmarks whose -P values contain this text, e.g. threads=4", cxxopts::value<std::string>())
+        ("since", "Only benchmarks from this date on, YYYY-MM-DD [HH:MM]", cxxopts::value<std::string>())
+        ("threshold", "Smallest change of the median runtime reported, e.g. 5%", cxxopts::value<std::string>()->default_value("5%"))
+        ("until", "Only benchmarks before this date, YYYY-MM-DD [HH:MM]", cxxopts::value<std::string>());
+
+    auto result = options.parse(argc, argv);
+
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+
+    std::string path = result.count("history") ? result["history"].as<std::string>() : defaultHistoryPath();
+    std::string command = result.count("command") ? result["command"].as<std::string>() : "";
+    std::string parameters = result.count("parameters") ? result["parameters"].as<std::string>() : "";
+    std::string host = result.count("host") ? result["host"].as<std::string>() : "";
+    long long since = result.count("since") ? parseDate(result["since"].as<std::string>()) : 0;
+    long long until = result.count("until") ? parseDate(result["until"].as<std::string>()) : 0;
+    double threshold = parsePercentage(result["threshold"].as<std::string>());
+
+    if (since < 0 || until < 0) {
+        std::cerr << "Error: Dates are YYYY-MM-DD or YYYY-MM-DD HH:MM." << std::endl;
+        return 1;
+    }
+
+    if (threshold < 0.0) {
+        std::cerr << "Error: --threshold must be a percentage." << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> fields;
+    std::istringstream list(result["group-by"].as<std::string>());
+    std::string field;
+    while (std::getline(list, field, ',')) {
+        if (field != "command" && field != "parameters" && field != "host" && field != "jobs" && field != "cpus") {
+            std::cerr << "Error: Unknown --group-by field " << field << "." << std::endl;
+            return 1;
+        }
+        fields.push_back(field);
+    }
+
+    std::vector<ReportGroup> groups;
+    std::unordered_map<std::string, size_t> groupIndex;
+    std::string key;
+
+    // The cheap metadata filters run before any run of the record is decoded
+    bool readable = scanHistory(path, [&](HistoryRecord& record) {
+        if ((since > 0 && record.timestamp < since) || (until > 0 && record.timestamp >= until) ||
+            record.command.find(command) == std::string::npos ||
+            record.parameters.find(parameters) == std::string::npos ||
+            record.host.find(host) == std::string::npos) {
+            return;
+        }
+
+        decodeRuns(record);
+        if (record.wall.empty()) {
+            return;
+        }
+
+        ReportRow row;
+        row.timestamp = record.timestamp;
+        row.runs = record.wall.size();
+        row.wall = median(record.wall);
+        row.user = mean(record.user);
+        row.system = mean(record.system);
+        row.maxrss = *std::max_element(record.maxrss.begin(), record.maxrss.end());
+
+        groupKey(record, fields, key);
+        auto found = groupIndex.find(key);
+        if (found == groupIndex.end()) {
+            found = groupIndex.insert({key, groups.size()}).first;
+            groups.push_back({key, {}});
+        }
+        groups[found->second].rows.push_back(row);
+    });
+
+    if (!readable) {
+        std::cerr << "Error: Cannot read history " << path << "." << std::endl;
+        return 1;
+    }
+
+    if (groups.empty()) {
+        std::cout << "No benchmarks in " << path << " match." << std::endl;
+        return 0;
+    }
+
+    for (auto& group : groups) {
+        // Appends from concurrent invocations may land slightly out of order
+        auto earlier = [](const ReportRow& a, const ReportRow& b) { return a.timestamp < b.timestamp; };
+        if (!std::is_sorted(group.rows.begin(), group.rows.end(), earlier)) {
+            std::stable_sort(group.rows.begin(), group.rows.end(), earlier);
+        }
+
+        printGroup(group, result["last"].as<size_t>(), threshold);
+    }
+
+    std::cout << std::endl;
+    return 0;
+}
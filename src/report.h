@@ -0,0 +1,8 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+// Function to run the `timez report` subcommand over the history, with
+// argv starting at "report"; returns the exit status
+int runReport(int argc, char** argv);
+
+#endif // REPORT_H
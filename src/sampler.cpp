@@ -0,0 +1,70 @@
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+
+#include "sampler.h"
+
+// Read a whole /proc file with a single read, they are generated on demand
+static bool readProcFile(const std::string& path, char* buffer, size_t size) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    ssize_t length = read(fd, buffer, size - 1);
+    close(fd);
+
+    if (length <= 0) {
+        return false;
+    }
+
+    buffer[length] = '\0';
+    return true;
+}
+
+// Value of a "Key: <n> kB" line, or -1 if the key is missing
+static long field(const char* text, const char* key) {
+    const char* line = strstr(text, key);
+
+    if (line == nullptr) {
+        return -1;
+    }
+
+    long value = -1;
+    sscanf(line + strlen(key), " %ld", &value);
+    return value;
+}
+
+bool sampleMemory(pid_t pid, MemorySample& sample) {
+    std::string proc = "/proc/" + std::to_string(pid);
+    char buffer[4096];
+
+    // Zombies still have a status file, but without any memory fields
+    if (!readProcFile(proc + "/status", buffer, sizeof(buffer))) {
+        return false;
+    }
+
+    sample.rss = field(buffer, "\nVmRSS:");
+    if (sample.rss < 0) {
+        return false;
+    }
+
+    sample.anon = field(buffer, "\nRssAnon:");
+    sample.file = field(buffer, "\nRssFile:");
+    sample.shmem = field(buffer, "\nRssShmem:");
+    sample.swap = field(buffer, "\nVmSwap:");
+
+    // PSS and USS need a page table walk, smaps_rollup does it in one go
+    if (readProcFile(proc + "/smaps_rollup", buffer, sizeof(buffer))) {
+        long clean = field(buffer, "\nPrivate_Clean:");
+        long dirty = field(buffer, "\nPrivate_Dirty:");
+
+        sample.pss = field(buffer, "\nPss:");
+        sample.uss = clean < 0 || dirty < 0 ? -1 : clean + dirty;
+    }
+
+    return true;
+}
@@ -0,0 +1,23 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <sys/types.h>
+
+// One reading of the memory of the command, sizes are in kilobytes and
+// negative when the kernel does not provide them
+struct MemorySample {
+    double time = 0.0; // Seconds since the launch
+    long rss = 0;
+    long anon = -1;
+    long file = -1;
+    long shmem = -1;
+    long pss = -1;
+    long uss = -1;
+    long swap = -1;
+};
+
+// Function to read the current memory of the process with the given pid,
+// returns false once the process has exited
+bool sampleMemory(pid_t pid, MemorySample& sample);
+
+#endif // SAMPLER_H
@@ -0,0 +1,228 @@
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <spawn.h>
+#include <unistd.h>
+
+#include <sys/syscall.h>
+
+#ifdef SYS_clone3
+#include <linux/sched.h>
+#endif
+
+#include "spawn.h"
+#include "utils.h"
+
+extern char** environ;
+
+// Only async-signal-safe calls are allowed between the launch and exec,
+// the vfork child shares our memory, so errors are reported with write(2)
+static void childFailed(const char* message) {
+    ssize_t ignored = write(STDERR_FILENO, message, strlen(message));
+    (void)ignored;
+    _exit(127);
+}
+
+// Apply the resource limits to pid (0 for ourselves), the CPU limit sends
+// SIGXCPU at the soft limit and SIGKILL one second later
+static bool applyLimits(pid_t pid, const ChildSetup& setup) {
+    if (setup.memoryLimit != RLIM_INFINITY) {
+        struct rlimit limit = {setup.memoryLimit, setup.memoryLimit};
+        if (prlimit(pid, RLIMIT_AS, &limit, nullptr) < 0) {
+            return false;
+        }
+    }
+
+    if (setup.cpuLimit != RLIM_INFINITY) {
+        struct rlimit limit = {setup.cpuLimit, setup.cpuLimit + 1};
+        if (prlimit(pid, RLIMIT_CPU, &limit, nullptr) < 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void execOrDie(std::vector<char*>& argv, const ChildSetup& setup, bool inCgroup) {
+    if (setup.stdoutFd >= 0 && dup2(setup.stdoutFd, STDOUT_FILENO) < 0) {
+        childFailed("Failed to redirect the output of the command.\n");
+    }
+
+    if (setup.processGroup && setpgid(0, 0) < 0) {
+        childFailed("Failed to create a process group.\n");
+    }
+
+    if (!applyLimits(0, setup)) {
+        childFailed("Failed to set the resource limits.\n");
+    }
+
+    if (setup.pinned && sched_setaffinity(0, sizeof(setup.affinity), &setup.affinity) < 0) {
+        childFailed("Failed to set the CPU affinity.\n");
+    }
+
+    // Writing 0 to cgroup.procs moves the writing process itself
+    if (setup.cgroupProcs >= 0 && !inCgroup && write(setup.cgroupProcs, "0", 1) != 1) {
+        childFailed("Failed to move command into its cgroup.\n");
+    }
+
+    execvp(argv[0], argv.data());
+
+    childFailed("Failed to execute command.\n");
+}
+
+bool parseSpawnMethod(const std::string& name, SpawnMethod& method) {
+    if (name == "fork") {
+        method = SpawnMethod::Fork;
+    } else if (name == "vfork") {
+        method = SpawnMethod::Vfork;
+    } else if (name == "posix_spawn") {
+        method = SpawnMethod::PosixSpawn;
+    } else if (name == "clone3") {
+        method = SpawnMethod::Clone3;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+std::vector<char*> buildArgv(const std::vector<std::string>& command) {
+    std::vector<char*> argv;
+    for (const auto& arg : command) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+
+    argv.push_back(nullptr);
+    return argv;
+}
+
+static pid_t spawnFork(std::vector<char*>& argv, const ChildSetup& setup) {
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        execOrDie(argv, setup, false);
+    }
+
+    return pid;
+}
+
+// The vfork child borrows our stack and memory until it execs, so it must
+// never return from this function and may only make async-signal-safe
+// calls on the way, which execOrDie keeps to
+static pid_t spawnVfork(std::vector<char*>& argv, const ChildSetup& setup) {
+    pid_t pid = vfork();
+
+    if (pid == 0) {
+        execOrDie(argv, setup, false);
+    }
+
+    return pid;
+}
+
+static pid_t spawnPosix(std::vector<char*>& argv, const ChildSetup& setup) {
+    pid_t pid;
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+
+    if (setup.processGroup) {
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attr, 0);
+    }
+
+    // There is no spawn attribute for the affinity, so we pin ourselves for
+    // the duration of the launch and the child inherits the mask
+    cpu_set_t previous;
+    if (setup.pinned) {
+        sched_getaffinity(0, sizeof(previous), &previous);
+        sched_setaffinity(0, sizeof(setup.affinity), &setup.affinity);
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+
+    if (setup.stdoutFd >= 0) {
+        posix_spawn_file_actions_adddup2(&actions, setup.stdoutFd, STDOUT_FILENO);
+    }
+
+    int ret = posix_spawnp(&pid, argv[0], &actions, &attr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    if (setup.pinned) {
+        sched_setaffinity(0, sizeof(previous), &previous);
+    }
+
+    if (ret != 0) {
+        std::cerr << "Failed to execute command: " << strerror(ret) << std::endl;
+        dead(1);
+    }
+
+    // posix_spawn cannot run code in the child, so limits are applied and it
+    // is moved into its cgroup right after the launch, which races with the
+    // start of the command; anything it forked before that is missed
+    if (!applyLimits(pid, setup)) {
+        std::cerr << "Failed to set the resource limits: " << strerror(errno) << std::endl;
+    }
+
+    if (setup.cgroupProcs >= 0) {
+        std::string value = std::to_string(pid);
+
+        if (write(setup.cgroupProcs, value.c_str(), value.size()) < 0) {
+            std::cerr << "Failed to move command into its cgroup: " << strerror(errno) << std::endl;
+        }
+    }
+
+    return pid;
+}
+
+static pid_t spawnClone3(std::vector<char*>& argv, const ChildSetup& setup) {
+#ifdef SYS_clone3
+    struct clone_args args;
+    memset(&args, 0, sizeof(args));
+    args.exit_signal = SIGCHLD;
+
+    // The child is born inside its cgroup, without a migration
+    if (setup.cgroupDir >= 0) {
+        args.flags |= CLONE_INTO_CGROUP;
+        args.cgroup = setup.cgroupDir;
+    }
+
+    pid_t pid = syscall(SYS_clone3, &args, sizeof(args));
+
+    if (pid == 0) {
+        execOrDie(argv, setup, setup.cgroupDir >= 0);
+    }
+
+    return pid;
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+pid_t spawnCommand(std::vector<char*>& argv, SpawnMethod method, const ChildSetup& setup) {
+    pid_t pid = -1;
+
+    switch (method) {
+        case SpawnMethod::Fork:
+            pid = spawnFork(argv, setup);
+            break;
+        case SpawnMethod::Vfork:
+            pid = spawnVfork(argv, setup);
+            break;
+        case SpawnMethod::PosixSpawn:
+            pid = spawnPosix(argv, setup);
+            break;
+        case SpawnMethod::Clone3:
+            pid = spawnClone3(argv, setup);
+            break;
+    }
+
+    if (pid < 0) {
+        std::cerr << "Failed to launch a new process: " << strerror(errno) << std::endl;
+        dead(1);
+    }
+
+    return pid;
+}
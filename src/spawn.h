@@ -0,0 +1,40 @@
+#ifndef SPAWN_H
+#define SPAWN_H
+
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sched.h>
+#include <sys/types.h>
+
+// Mechanisms available to launch the measured command
+enum class SpawnMethod {
+    Fork,
+    Vfork,
+    PosixSpawn,
+    Clone3
+};
+
+// Settings applied to the child between the launch and exec
+struct ChildSetup {
+    std::string cgroupPath; // Path of the cgroup the child should run in, if any
+    int cgroupDir = -1;   // Directory of the cgroup the child should run in
+    int cgroupProcs = -1; // cgroup.procs of that cgroup, opened for writing
+    rlim_t memoryLimit = RLIM_INFINITY; // Address space limit in bytes
+    rlim_t cpuLimit = RLIM_INFINITY;    // CPU time limit in seconds
+    bool processGroup = false; // Lead a new process group so it can be killed as a whole
+    bool pinned = false;       // Restrict the child to the CPUs in affinity
+    int stdoutFd = -1;         // Becomes the child's stdout when set
+    cpu_set_t affinity;
+};
+
+// Function to parse a spawn method name, returns false if it is unknown
+bool parseSpawnMethod(const std::string& name, SpawnMethod& method);
+
+// Function to build a null-terminated argument vector for exec
+std::vector<char*> buildArgv(const std::vector<std::string>& command);
+
+// Function to launch the command with the given method and return its pid
+pid_t spawnCommand(std::vector<char*>& argv, SpawnMethod method, const ChildSetup& setup);
+
+#endif // SPAWN_H
@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+#include "stats.h"
+
+Summary summarize(std::vector<double> samples) {
+    Summary summary = summarizeMoments(samples);
+
+    if (samples.empty()) {
+        return summary;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    size_t n = samples.size();
+    summary.min = samples.front();
+    summary.max = samples.back();
+
+    if (n % 2 == 0) {
+        summary.median = (samples[n / 2 - 1] + samples[n / 2]) / 2.0;
+    } else {
+        summary.median = samples[n / 2];
+    }
+
+    return summary;
+}
+
+Summary summarizeMoments(const std::vector<double>& samples) {
+    Summary summary;
+
+    if (samples.empty()) {
+        return summary;
+    }
+
+    size_t n = samples.size();
+    summary.count = n;
+
+    double sum = 0.0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+    summary.mean = sum / n;
+
+    // Sample standard deviation, zero when there is only one sample
+    if (n > 1) {
+        double squares = 0.0;
+        for (double sample : samples) {
+            squares += (sample - summary.mean) * (sample - summary.mean);
+        }
+        summary.stddev = std::sqrt(squares / (n - 1));
+    }
+
+    return summary;
+}
+
+double studentT95(size_t degreesOfFreedom) {
+    static const double table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+
+    if (degreesOfFreedom == 0) {
+        return INFINITY;
+    }
+
+    if (degreesOfFreedom <= 30) {
+        return table[degreesOfFreedom - 1];
+    }
+
+    // Cornish-Fisher expansion around the normal quantile
+    double z = 1.959964;
+    double df = degreesOfFreedom;
+    return z + (z * z * z + z) / (4 * df)
+             + (5 * std::pow(z, 5) + 16 * z * z * z + 3 * z) / (96 * df * df);
+}
+
+double confidenceHalfWidth(const Summary& summary) {
+    if (summary.count < 2) {
+        return INFINITY;
+    }
+
+    return studentT95(summary.count - 1) * summary.stddev / std::sqrt(summary.count);
+}
+
+// Small and fast xorshift generator, the bootstrap needs many millions of
+// indices and no cryptographic quality
+static inline uint64_t nextRandom(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// Fill means and medians [first, last) from as many resamples of the
+// sorted samples. A resample is kept as the number of times each sample
+// was drawn, so both statistics come from one pass over the counts.
+static void resample(const std::vector<double>& sorted, uint64_t seed,
+                     std::vector<double>& means, std::vector<double>& medians,
+                     size_t first, size_t last) {
+    uint64_t state = seed * 0x9E3779B97F4A7C15ULL | 1;
+    size_t n = sorted.size();
+    std::vector<uint32_t> drawn(n);
+
+    for (size_t i = first; i < last; i++) {
+        std::fill(drawn.begin(), drawn.end(), 0);
+
+        for (size_t k = 0; k < n; k++) {
+            // Multiply and shift maps 32 random bits onto [0, n)
+            drawn[((nextRandom(state) >> 32) * n) >> 32]++;
+        }
+
+        double sum = 0.0;
+        size_t seen = 0, middle = (n + 1) / 2;
+        bool found = false;
+
+        for (size_t k = 0; k < n; k++) {
+            sum += drawn[k] * sorted[k];
+            seen += drawn[k];
+
+            if (!found && seen >= middle) {
+                medians[i] = sorted[k];
+                found = true;
+            }
+        }
+
+        means[i] = sum / n;
+    }
+}
+
+static Interval percentileInterval(std::vector<double>& estimates) {
+    std::sort(estimates.begin(), estimates.end());
+
+    Interval interval;
+    interval.low = estimates[size_t(0.025 * (estimates.size() - 1))];
+    interval.high = estimates[size_t(0.975 * (estimates.size() - 1))];
+    return interval;
+}
+
+Bootstrap bootstrap(const std::vector<double>& samples, size_t resamples) {
+    Bootstrap result;
+
+    if (samples.empty() || resamples == 0) {
+        return result;
+    }
+
+    std::vector<double> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+
+    std::vector<double> means(resamples), medians(resamples);
+
+    // Small sample sets are not worth starting threads for, and the fixed
+    // seeds keep reports reproducible
+    size_t threads = 1;
+    if (samples.size() * resamples >= 1000000) {
+        threads = std::max(1u, std::min(std::thread::hardware_concurrency(), 16u));
+    }
+
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; t++) {
+        workers.emplace_back(resample, std::cref(sorted), t + 1, std::ref(means), std::ref(medians),
+                             resamples * t / threads, resamples * (t + 1) / threads);
+    }
+    resample(sorted, 1, means, medians, 0, resamples / threads);
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    result.mean = percentileInterval(means);
+    result.median = percentileInterval(medians);
+    return result;
+}
+
+std::vector<bool> findOutliers(const std::vector<double>& samples, double threshold) {
+    std::vector<bool> outliers(samples.size(), false);
+
+    // Too few samples to tell what is typical
+    if (samples.size() < 3) {
+        return outliers;
+    }
+
+    double median = summarize(samples).median;
+
+    std::vector<double> deviations;
+    for (double sample : samples) {
+        deviations.push_back(std::fabs(sample - median));
+    }
+    double mad = summarize(deviations).median;
+
+    // More than half the samples are identical, nothing stands out
+    if (mad == 0.0) {
+        return outliers;
+    }
+
+    // 0.6745 scales the MAD to the standard deviation of a normal distribution
+    for (size_t i = 0; i < samples.size(); i++) {
+        outliers[i] = 0.6745 * std::fabs(samples[i] - median) / mad > threshold;
+    }
+
+    return outliers;
+}
+
+// Normal approximation with tie and continuity correction, which is close
+// enough from about eight samples on each side
+double mannWhitneyU(const std::vector<double>& a, const std::vector<double>& b) {
+    std::vector<std::pair<double, bool>> pooled;
+    pooled.reserve(a.size() + b.size());
+    for (double sample : a) {
+        pooled.push_back({sample, true});
+    }
+    for (double sample : b) {
+        pooled.push_back({sample, false});
+    }
+
+    std::sort(pooled.begin(), pooled.end());
+
+    double n1 = a.size(), n2 = b.size(), n = pooled.size();
+    double rankSum = 0.0, ties = 0.0;
+
+    // Tied samples all get the average of their ranks
+    for (size_t i = 0; i < pooled.size();) {
+        size_t j = i;
+        while (j < pooled.size() && pooled[j].first == pooled[i].first) {
+            j++;
+        }
+
+        double rank = (i + 1 + j) / 2.0;
+        for (size_t k = i; k < j; k++) {
+            if (pooled[k].second) {
+                rankSum += rank;
+            }
+        }
+
+        double t = j - i;
+        ties += t * t * t - t;
+        i = j;
+    }
+
+    if (n1 == 0 || n2 == 0) {
+        return 1.0;
+    }
+
+    double u = rankSum - n1 * (n1 + 1) / 2;
+    double mean = n1 * n2 / 2;
+    double variance = n1 * n2 / 12 * ((n + 1) - ties / (n * (n - 1)));
+
+    if (variance <= 0.0) {
+        return 1.0;
+    }
+
+    double z = std::max(std::fabs(u - mean) - 0.5, 0.0) / std::sqrt(variance);
+    return std::erfc(z / std::sqrt(2.0));
+}
+
+// Both models linearize to N / S(N) - 1 = sigma (N - 1) + kappa N (N - 1),
+// which is fitted by least squares through the origin
+ScalingFit fitAmdahl(const std::vector<double>& concurrency, const std::vector<double>& speedup) {
+    ScalingFit fit;
+    double xy = 0.0, xx = 0.0;
+
+    for (size_t i = 0; i < concurrency.size(); i++) {
+        double n = concurrency[i];
+        double y = n / speedup[i] - 1;
+        xy += (n - 1) * y;
+        xx += (n - 1) * (n - 1);
+    }
+
+    // Faster than linear speedups are noise, not a negative serial fraction,
+    // and falling throughput is beyond a fully serial one
+    if (xx > 0.0) {
+        fit.sigma = std::min(std::max(xy / xx, 0.0), 1.0);
+    }
+
+    return fit;
+}
+
+ScalingFit fitUsl(const std::vector<double>& concurrency, const std::vector<double>& speedup) {
+    double s11 = 0.0, s12 = 0.0, s22 = 0.0, s1y = 0.0, s2y = 0.0;
+
+    for (size_t i = 0; i < concurrency.size(); i++) {
+        double n = concurrency[i];
+        double x1 = n - 1;
+        double x2 = n * (n - 1);
+        double y = n / speedup[i] - 1;
+
+        s11 += x1 * x1;
+        s12 += x1 * x2;
+        s22 += x2 * x2;
+        s1y += x1 * y;
+        s2y += x2 * y;
+    }
+
+    // With fewer than two distinct levels above one only Amdahl can be fitted
+    double determinant = s11 * s22 - s12 * s12;
+    if (std::fabs(determinant) < 1e-12 * std::max(1.0, s11 * s22)) {
+        return fitAmdahl(concurrency, speedup);
+    }
+
+    ScalingFit fit;
+    fit.sigma = (s1y * s22 - s2y * s12) / determinant;
+    fit.kappa = (s2y * s11 - s1y * s12) / determinant;
+
+    // Neither coefficient may be negative, when one is the other is refitted
+    // on its own, which is the least squares solution on that boundary
+    if (fit.sigma < 0.0) {
+        fit.sigma = 0.0;
+        fit.kappa = s22 > 0.0 ? std::max(s2y / s22, 0.0) : 0.0;
+    } else if (fit.kappa < 0.0) {
+        fit.kappa = 0.0;
+        fit.sigma = s11 > 0.0 ? std::max(s1y / s11, 0.0) : 0.0;
+    }
+
+    return fit;
+}
+
+double predictSpeedup(const ScalingFit& fit, double n) {
+    return n / (1 + fit.sigma * (n - 1) + fit.kappa * n * (n - 1));
+}
@@ -0,0 +1,71 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstddef>
+#include <vector>
+
+// Summary statistics of a set of samples
+struct Summary {
+    size_t count = 0;
+    double min = 0.0;
+    double max = 0.0;
+    double mean = 0.0;
+    double median = 0.0;
+    double stddev = 0.0;
+};
+
+// Function to compute summary statistics of the given samples
+Summary summarize(std::vector<double> samples);
+
+// Function to compute only the count, mean and standard deviation of the
+// given samples, which needs no sorting
+Summary summarizeMoments(const std::vector<double>& samples);
+
+// Function to return the two-sided 95% quantile of Student's t distribution
+double studentT95(size_t degreesOfFreedom);
+
+// Function to return the half width of the 95% confidence interval of the mean
+double confidenceHalfWidth(const Summary& summary);
+
+// Bounds of a confidence interval
+struct Interval {
+    double low = 0.0;
+    double high = 0.0;
+};
+
+// Bootstrap intervals of the mean and the median of a set of samples
+struct Bootstrap {
+    Interval mean;
+    Interval median;
+};
+
+// Function to return the 95% percentile bootstrap intervals of the mean and
+// the median of the samples, resampled on all CPUs
+Bootstrap bootstrap(const std::vector<double>& samples, size_t resamples = 2000);
+
+// Function to flag the samples whose modified z-score, based on the median
+// absolute deviation, is above threshold
+std::vector<bool> findOutliers(const std::vector<double>& samples, double threshold = 3.5);
+
+// Function to return the two-sided p-value of the Mann-Whitney U test that
+// both sets of samples come from the same distribution
+double mannWhitneyU(const std::vector<double>& a, const std::vector<double>& b);
+
+// Parameters of the Universal Scalability Law, Amdahl's law has kappa = 0
+struct ScalingFit {
+    double sigma = 0.0; // Contention, the serial fraction
+    double kappa = 0.0; // Coherency delay
+};
+
+// Function to fit Amdahl's law to speedups measured at the given concurrency,
+// sigma is kept within [0, 1]
+ScalingFit fitAmdahl(const std::vector<double>& concurrency, const std::vector<double>& speedup);
+
+// Function to fit the Universal Scalability Law to the measured speedups,
+// sigma and kappa are never negative
+ScalingFit fitUsl(const std::vector<double>& concurrency, const std::vector<double>& speedup);
+
+// Function to return the speedup a fitted model predicts at concurrency n
+double predictSpeedup(const ScalingFit& fit, double n);
+
+#endif // STATS_H
@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+
+#include "store.h"
+
+// The history is a single append-only file of self-contained records:
+//
+//   magic "TZR1" | payload length (u32) | CRC-32 of the payload (u32) | payload
+//
+// Every record goes out in one write() on an O_APPEND descriptor, so
+// appends never touch what is already stored and cost the same no matter
+// how large the file grows. A record torn by a crash fails its length or
+// checksum, and readers skip ahead to the next magic.
+static const char recordMagic[4] = {'T', 'Z', 'R', '1'};
+static const unsigned recordVersion = 1;
+
+// Slicing-by-8 CRC-32, reading the history checks every record and this
+// is most of the cost of a scan
+static uint32_t crc32(const unsigned char* data, size_t size) {
+    static uint32_t table[8][256];
+    static bool ready = false;
+
+    if (!ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            table[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int slice = 1; slice < 8; slice++) {
+                table[slice][i] = table[0][table[slice - 1][i] & 0xFF] ^ (table[slice - 1][i] >> 8);
+            }
+        }
+        ready = true;
+    }
+
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (; size >= 8; data += 8, size -= 8) {
+        uint32_t low = crc ^ (data[0] | data[1] << 8 | data[2] << 16 | static_cast<uint32_t>(data[3]) << 24);
+        crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^
+              table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+              table[3][data[4]] ^ table[2][data[5]] ^ table[1][data[6]] ^ table[0][data[7]];
+    }
+
+    for (; size > 0; data++, size--) {
+        crc = table[0][(crc ^ *data) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc ^ 0xFFFFFFFF;
+}
+
+// Integers are stored as LEB128 varints, most values take one to three bytes
+static void putNumber(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+static void putString(std::string& out, const std::string& text) {
+    putNumber(out, text.size());
+    out += text;
+}
+
+static void putWord(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out += static_cast<char>(value >> (8 * i));
+    }
+}
+
+// Readers return false instead of running past the end of a record
+static bool getNumber(const unsigned char*& at, const unsigned char* end, uint64_t& value) {
+    value = 0;
+
+    for (int shift = 0; at < end && shift < 64; shift += 7) {
+        unsigned char byte = *at++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool getString(const unsigned char*& at, const unsigned char* end, std::string& text) {
+    uint64_t size;
+
+    if (!getNumber(at, end, size) || size > static_cast<uint64_t>(end - at)) {
+        return false;
+    }
+
+    text.assign(reinterpret_cast<const char*>(at), size);
+    at += size;
+    return true;
+}
+
+static uint32_t getWord(const unsigned char* at) {
+    return at[0] | at[1] << 8 | at[2] << 16 | static_cast<uint32_t>(at[3]) << 24;
+}
+
+static uint64_t toMicroseconds(const struct timeval& tv) {
+    return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+// First value of a "key : value" line of a /proc file
+static std::string procValue(const char* path, const std::string& key) {
+    std::ifstream file(path);
+    std::string line;
+
+    while (std::getline(file, line)) {
+        if (line.compare(0, key.size(), key) == 0) {
+            size_t colon = line.find(':');
+            size_t start = line.find_first_not_of(" \t", colon + 1);
+            return start == std::string::npos ? "" : line.substr(start);
+        }
+    }
+
+    return "";
+}
+
+// Enough about the machine to tell apart results that are not comparable
+static const std::string& hostFingerprint() {
+    static std::string fingerprint;
+
+    if (fingerprint.empty()) {
+        struct utsname name;
+        uname(&name);
+
+        fingerprint = std::string("host=") + name.nodename
+                    + ";kernel=" + name.release
+                    + ";arch=" + name.machine
+                    + ";cpu=" + procValue("/proc/cpuinfo", "model name")
+                    + ";cpus=" + std::to_string(sysconf(_SC_NPROCESSORS_ONLN))
+                    + ";memory=" + procValue("/proc/meminfo", "MemTotal");
+    }
+
+    return fingerprint;
+}
+
+std::string defaultHistoryPath() {
+    const char* data = getenv("XDG_DATA_HOME");
+    const char* home = getenv("HOME");
+
+    if (data != nullptr && *data != '\0') {
+        return std::string(data) + "/timez/history";
+    }
+
+    return std::string(home != nullptr ? home : ".") + "/.local/share/timez/history";
+}
+
+// Create the directories leading up to path
+static bool makeParents(const std::string& path) {
+    for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+        if (mkdir(path.substr(0, slash).c_str(), 0755) == -1 && errno != EEXIST) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void appendHistory(const Benchmark& benchmark) {
+    const std::vector<RunResult>& runs = benchmark.results;
+
+    if (historyPath.empty() || runs.empty()) {
+        return;
+    }
+
+    std::string line;
+    for (const auto& word : benchmark.command) {
+        line += (line.empty() ? "" : " ") + word;
+    }
+
+    std::string payload;
+    putNumber(payload, recordVersion);
+    putNumber(payload, time(nullptr));
+    putString(payload, line);
+    putString(payload, benchmark.values);
+    putString(payload, hostFingerprint());
+    putNumber(payload, benchmark.jobs);
+    putNumber(payload, benchmark.pinnedCpus);
+    putNumber(payload, runs.size());
+
+    for (const auto& run : runs) {
+        putNumber(payload, run.runtime.count());
+        putNumber(payload, toMicroseconds(run.usage.ru_utime));
+        putNumber(payload, toMicroseconds(run.usage.ru_stime));
+        putNumber(payload, run.usage.ru_maxrss);
+        putNumber(payload, static_cast<unsigned>(run.status));
+    }
+
+    std::string record(recordMagic, sizeof(recordMagic));
+    putWord(record, payload.size());
+    putWord(record, crc32(reinterpret_cast<const unsigned char*>(payload.data()), payload.size()));
+    record += payload;
+
+    // History is a convenience, failing to keep it never fails the benchmark
+    int fd = -1;
+    if (makeParents(historyPath)) {
+        fd = open(historyPath.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    }
+
+    if (fd == -1) {
+        std::cerr << "Warning: Cannot open history " << historyPath << ": " << strerror(errno) << std::endl;
+        return;
+    }
+
+    if (write(fd, record.data(), record.size()) != static_cast<ssize_t>(record.size()) || fdatasync(fd) == -1) {
+        std::cerr << "Warning: Cannot append to history " << historyPath << ": " << strerror(errno) << std::endl;
+    }
+
+    close(fd);
+}
+
+// Decode the metadata of the payload between at and end
+static bool decodeRecord(const unsigned char* at, const unsigned char* end, HistoryRecord& record) {
+    uint64_t version, timestamp, jobs, cpus, runCount;
+
+    if (!getNumber(at, end, version) || version != recordVersion) {
+        return false;
+    }
+
+    if (!getNumber(at, end, timestamp) || !getString(at, end, record.command) ||
+        !getString(at, end, record.parameters) || !getString(at, end, record.host) ||
+        !getNumber(at, end, jobs) || !getNumber(at, end, cpus) || !getNumber(at, end, runCount)) {
+        return false;
+    }
+
+    record.timestamp = timestamp;
+    record.jobs = jobs;
+    record.cpus = cpus;
+    record.runCount = runCount;
+    record.runData = at;
+    record.end = end;
+    record.wall.clear();
+    record.user.clear();
+    record.system.clear();
+    record.maxrss.clear();
+    return true;
+}
+
+void decodeRuns(HistoryRecord& record) {
+    const unsigned char* at = record.runData;
+    uint64_t wall, user, system, maxrss, status;
+
+    for (size_t i = 0; i < record.runCount; i++) {
+        if (!getNumber(at, record.end, wall) || !getNumber(at, record.end, user) ||
+            !getNumber(at, record.end, system) || !getNumber(at, record.end, maxrss) ||
+            !getNumber(at, record.end, status)) {
+            break;
+        }
+
+        record.wall.push_back(wall);
+        record.user.push_back(user);
+        record.system.push_back(system);
+        record.maxrss.push_back(maxrss);
+    }
+}
+
+bool scanHistory(const std::string& path, const std::function<void(HistoryRecord&)>& visit) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) == -1) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = status.st_size;
+    if (size == 0) {
+        close(fd);
+        return true;
+    }
+
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    const unsigned char* begin = static_cast<const unsigned char*>(mapped);
+    const unsigned char* end = begin + size;
+    const unsigned char* at = begin;
+    const size_t headerSize = sizeof(recordMagic) + 8;
+    HistoryRecord record;
+
+    while (static_cast<size_t>(end - at) >= headerSize) {
+        const unsigned char* payload = at + headerSize;
+        uint32_t length = getWord(at + 4);
+
+        bool intact = memcmp(at, recordMagic, sizeof(recordMagic)) == 0 &&
+                      length <= static_cast<size_t>(end - payload) &&
+                      crc32(payload, length) == getWord(at + 8) &&
+                      decodeRecord(payload, payload + length, record);
+
+        if (intact) {
+            visit(record);
+            at = payload + length;
+            continue;
+        }
+
+        // A torn or foreign record, carry on from the next magic
+        const void* next = memmem(at + 1, end - at - 1, recordMagic, sizeof(recordMagic));
+        at = next != nullptr ? static_cast<const unsigned char*>(next) : end;
+    }
+
+    munmap(mapped, size);
+    return true;
+}
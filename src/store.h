@@ -0,0 +1,43 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "timez.h"
+
+// One benchmark read back from the history, the runs are only decoded on
+// request since most queries look at the metadata first
+struct HistoryRecord {
+    long long timestamp;
+    std::string command;
+    std::string parameters;
+    std::string host;
+    unsigned jobs;
+    unsigned cpus;
+    size_t runCount;
+    std::vector<double> wall;   // Microseconds
+    std::vector<double> user;   // Microseconds
+    std::vector<double> system; // Microseconds
+    std::vector<double> maxrss; // Kilobytes
+    const unsigned char* runData;
+    const unsigned char* end;
+};
+
+// Function to return the history file used when --history is not given,
+// in the XDG data directory
+std::string defaultHistoryPath();
+
+// Function to append one benchmark, its runs and where and when it was
+// measured to the history
+void appendHistory(const Benchmark& benchmark);
+
+// Function to memory-map the history at path and pass every intact record
+// to visit in file order, returns false if the file cannot be read
+bool scanHistory(const std::string& path, const std::function<void(HistoryRecord&)>& visit);
+
+// Function to decode the runs of a record passed to the visitor of
+// scanHistory, only valid while the visitor runs
+void decodeRuns(HistoryRecord& record);
+
+#endif // STORE_H
@@ -0,0 +1,396 @@
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+
+#include "supervisor.h"
+#include "utils.h"
+
+// glibc only gained wrappers for these recently, so call them directly
+static int openPidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return syscall(SYS_pidfd_open, pid, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static int signalPidfd(int pidfd, int signal) {
+#ifdef SYS_pidfd_send_signal
+    return syscall(SYS_pidfd_send_signal, pidfd, signal, nullptr, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// Self-pipe the forwarding handler writes signal numbers to
+static int signalPipe[2] = {-1, -1};
+static int interruptedBy = 0;
+
+static void onSignal(int signal) {
+    int saved = errno;
+    char number = signal;
+    ssize_t ignored = write(signalPipe[1], &number, 1);
+    (void)ignored;
+    errno = saved;
+}
+
+// Children that lead their own group do not see the signals the terminal
+// or a parent send to us, so we catch those and pass them on. Handlers are
+// reset by exec, so the children start with the default dispositions.
+static void installForwarding() {
+    if (signalPipe[0] >= 0) {
+        return;
+    }
+
+    if (pipe2(signalPipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+        std::cerr << "Failed to set up the supervisor for the command." << std::endl;
+        dead(1);
+    }
+
+    struct sigaction action = {};
+    action.sa_handler = onSignal;
+    sigemptyset(&action.sa_mask);
+
+    // Signals ignored by whoever started us stay ignored, as shells expect
+    for (int signal : {SIGINT, SIGTERM, SIGHUP}) {
+        struct sigaction previous;
+        sigaction(signal, nullptr, &previous);
+
+        if (previous.sa_handler != SIG_IGN) {
+            sigaction(signal, &action, nullptr);
+        }
+    }
+}
+
+int interruption() {
+    return interruptedBy;
+}
+
+// Make group the foreground process group of our terminal. Doing so from
+// the background raises SIGTTOU, which is blocked around the call.
+static void giveTerminal(pid_t group) {
+    sigset_t block, previous;
+    sigemptyset(&block);
+    sigaddset(&block, SIGTTOU);
+
+    sigprocmask(SIG_BLOCK, &block, &previous);
+    tcsetpgrp(STDIN_FILENO, group);
+    sigprocmask(SIG_SETMASK, &previous, nullptr);
+}
+
+static bool armTimer(int timerfd, double seconds, bool periodic) {
+    struct itimerspec spec = {};
+    spec.it_value.tv_sec = static_cast<time_t>(seconds);
+    spec.it_value.tv_nsec = static_cast<long>((seconds - std::floor(seconds)) * 1e9);
+
+    // A zero it_value would disarm the timer instead of firing at once
+    if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+        spec.it_value.tv_nsec = 1;
+    }
+
+    if (periodic) {
+        spec.it_interval = spec.it_value;
+    }
+
+    return timerfd_settime(timerfd, 0, &spec, nullptr) == 0;
+}
+
+static int openTimer(double seconds, bool periodic) {
+    int timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+
+    if (timerfd >= 0 && !armTimer(timerfd, seconds, periodic)) {
+        close(timerfd);
+        return -1;
+    }
+
+    return timerfd;
+}
+
+// The group id stays ours while the unreaped leader holds on to its pid,
+// the pidfd covers the leader in case it never got to create the group
+static void signalGroup(Child& child, int signal) {
+    if (!child.exited && kill(-child.pid, signal) < 0) {
+        signalPidfd(child.pidfd, signal);
+    }
+
+    // Processes that left the group are still in the cgroup
+    if (signal == SIGKILL && child.cgroupDir >= 0) {
+        int killfd = openat(child.cgroupDir, "cgroup.kill", O_WRONLY | O_CLOEXEC);
+
+        if (killfd >= 0) {
+            ssize_t ignored = write(killfd, "1", 1);
+            (void)ignored;
+            close(killfd);
+        }
+    } else if (child.cgroupDir >= 0) {
+        int procsfd = openat(child.cgroupDir, "cgroup.procs", O_RDONLY | O_CLOEXEC);
+        FILE* procs = procsfd >= 0 ? fdopen(procsfd, "r") : nullptr;
+        int pid;
+
+        while (procs != nullptr && fscanf(procs, "%d", &pid) == 1) {
+            kill(pid, signal);
+        }
+
+        if (procs != nullptr) {
+            fclose(procs);
+        } else if (procsfd >= 0) {
+            close(procsfd);
+        }
+    }
+}
+
+// Pass the signals caught since the last call on to every child
+static void forwardSignals(std::vector<Child*>& children) {
+    char number;
+
+    while (read(signalPipe[0], &number, 1) == 1) {
+        interruptedBy = number;
+
+        for (auto child : children) {
+            if (child->group && !child->exited) {
+                signalGroup(*child, number);
+            }
+        }
+    }
+}
+
+static void reap(Child& child) {
+    while (wait4(child.pid, &child.status, 0, &child.usage) < 0) {
+        if (errno != EINTR) {
+            std::cerr << "Failed to wait for the command." << std::endl;
+            dead(1);
+        }
+    }
+
+    child.exited = true;
+}
+
+static void closeFd(int& fd) {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+static void drainTimer(int timerfd) {
+    uint64_t expirations;
+    ssize_t ignored = read(timerfd, &expirations, sizeof(expirations));
+    (void)ignored;
+}
+
+// Whether the cgroup still has processes, cgroup.events signals POLLPRI
+// whenever that changes
+static bool populated(int eventsfd) {
+    char buffer[256];
+    ssize_t length = pread(eventsfd, buffer, sizeof(buffer) - 1, 0);
+
+    if (length <= 0) {
+        return false;
+    }
+
+    buffer[length] = '\0';
+    return strstr(buffer, "populated 1") != nullptr;
+}
+
+void watchChild(Child& child, double timeout, double sampleInterval) {
+    if (timeout > 0.0) {
+        child.timerfd = openTimer(timeout, false);
+        child.group = true;
+        installForwarding();
+
+        // The child may not have reached its own setpgid yet
+        setpgid(child.pid, child.pid);
+    }
+
+    // Only the foreground group may read the terminal, without it commands
+    // that do would be stopped by SIGTTIN until the watchdog fires
+    child.foreground = child.foreground && child.group && isatty(STDIN_FILENO)
+                    && tcgetpgrp(STDIN_FILENO) == getpgrp();
+
+    if (child.foreground) {
+        giveTerminal(child.pid);
+    }
+
+    if (sampleInterval > 0.0 && child.samples != nullptr) {
+        child.samplefd = openTimer(sampleInterval, true);
+    }
+
+    if (child.cgroupDir >= 0) {
+        child.eventsfd = openat(child.cgroupDir, "cgroup.events", O_RDONLY | O_CLOEXEC);
+    }
+
+    if ((timeout > 0.0 && child.timerfd < 0)
+        || (child.samples != nullptr && sampleInterval > 0.0 && child.samplefd < 0)) {
+        std::cerr << "Failed to set up the supervisor for the command." << std::endl;
+        kill(child.pid, SIGKILL);
+        reap(child);
+        dead(1);
+    }
+}
+
+static void onTimer(Child& child, double grace) {
+    drainTimer(child.timerfd);
+
+    if (child.termination == Termination::OnTime && grace > 0.0 && !child.exited) {
+        // Give the group a chance to shut down, the timer now counts down
+        // the grace period
+        std::cerr << "Duration exceeded. Terminating process group " << child.pid << std::endl;
+        signalGroup(child, SIGTERM);
+        armTimer(child.timerfd, grace, false);
+        child.termination = Termination::Terminated;
+    } else {
+        std::cerr << "Duration exceeded. Killing process group " << child.pid << std::endl;
+        signalGroup(child, SIGKILL);
+        child.termination = Termination::Killed;
+
+        // Nothing left to escalate, wait for the child to go away
+        closeFd(child.timerfd);
+    }
+}
+
+static void onSample(Child& child) {
+    drainTimer(child.samplefd);
+
+    MemorySample sample;
+    if (!child.exited && sampleMemory(child.pid, sample)) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - child.started;
+        sample.time = elapsed.count();
+        child.samples->push_back(sample);
+    }
+}
+
+static void onExit(Child& child) {
+    // The rest of the group already got SIGTERM, do not leave it running
+    // into the next measurement; the zombie leader still pins the group id
+    if (child.termination != Termination::OnTime) {
+        signalGroup(child, SIGKILL);
+    }
+
+    reap(child);
+    closeFd(child.pidfd);
+    closeFd(child.samplefd);
+
+    if (child.foreground) {
+        giveTerminal(getpgrp());
+
+        // Keys such as Ctrl-C only reached the child while it had the terminal
+        if (WIFSIGNALED(child.status) && (WTERMSIG(child.status) == SIGINT || WTERMSIG(child.status) == SIGQUIT)) {
+            interruptedBy = WTERMSIG(child.status);
+        }
+    }
+
+    // Descendants left in the cgroup still count towards the run
+    if (child.eventsfd < 0 || !populated(child.eventsfd)) {
+        child.ended = std::chrono::steady_clock::now();
+        closeFd(child.eventsfd);
+    }
+}
+
+static void onEmptied(Child& child) {
+    if (!populated(child.eventsfd)) {
+        child.ended = std::chrono::steady_clock::now();
+        closeFd(child.eventsfd);
+    }
+}
+
+// A child is done once it is reaped and nothing is left in its cgroup, the
+// end time is taken when that happens rather than when we get around to it
+static bool finished(Child& child) {
+    if (!child.exited || child.eventsfd >= 0) {
+        return false;
+    }
+
+    closeFd(child.timerfd);
+    return true;
+}
+
+size_t waitForChildren(std::vector<Child*>& children, double grace) {
+    // A lone child without anything to watch is simply waited for
+    if (children.size() == 1 && !children[0]->exited && children[0]->timerfd < 0
+        && children[0]->samplefd < 0 && children[0]->eventsfd < 0) {
+        Child& child = *children[0];
+        reap(child);
+        child.ended = std::chrono::steady_clock::now();
+        return 0;
+    }
+
+    // The children are not reaped until we call wait4, so the pidfds are
+    // guaranteed to refer to them and signals cannot hit a recycled pid
+    for (auto child : children) {
+        if (child->pidfd < 0 && !child->exited) {
+            child->pidfd = openPidfd(child->pid);
+
+            if (child->pidfd < 0) {
+                std::cerr << "Failed to set up the supervisor for the command." << std::endl;
+                dead(1);
+            }
+        }
+    }
+
+    // poll ignores negative descriptors, so unused slots are simply skipped;
+    // the last one is for the forwarded signals
+    std::vector<struct pollfd> fds(children.size() * 4 + 1);
+    fds.back() = {signalPipe[0], POLLIN, 0};
+
+    while (true) {
+        for (size_t i = 0; i < children.size(); i++) {
+            Child& child = *children[i];
+            fds[i * 4] = {child.pidfd, POLLIN, 0};
+            fds[i * 4 + 1] = {child.timerfd, POLLIN, 0};
+            fds[i * 4 + 2] = {child.samplefd, POLLIN, 0};
+            fds[i * 4 + 3] = {child.exited ? child.eventsfd : -1, POLLPRI, 0};
+
+            if (finished(child)) {
+                return i;
+            }
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            std::cerr << "Failed to poll the command." << std::endl;
+            dead(1);
+        }
+
+        if (fds.back().revents & POLLIN) {
+            forwardSignals(children);
+        }
+
+        for (size_t i = 0; i < children.size(); i++) {
+            Child& child = *children[i];
+
+            if (fds[i * 4 + 2].revents & POLLIN) {
+                onSample(child);
+            }
+
+            if (fds[i * 4 + 1].revents & POLLIN) {
+                onTimer(child, grace);
+            }
+
+            // The pidfd becomes readable as soon as the child exits
+            if (fds[i * 4].revents & POLLIN) {
+                onExit(child);
+            }
+
+            if (fds[i * 4 + 3].revents & POLLPRI) {
+                onEmptied(child);
+            }
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <chrono>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include "sampler.h"
+
+// How a supervised child came to an end
+enum class Termination {
+    OnTime,     // Exited before the timeout
+    Terminated, // Exited after SIGTERM, within the grace period
+    Killed      // Needed SIGKILL
+};
+
+// A launched child under supervision and, once it has ended, how it ended
+struct Child {
+    pid_t pid = -1;
+    int cgroupDir = -1; // Run cgroup that also has to become empty, or -1
+    std::vector<MemorySample>* samples = nullptr;
+    std::chrono::steady_clock::time_point started;
+    bool foreground = false; // Hand it the terminal while it runs, if we have it
+
+    // Filled in by the supervisor
+    std::chrono::steady_clock::time_point ended;
+    Termination termination = Termination::OnTime;
+    int status = 0;
+    struct rusage usage;
+
+    int pidfd = -1;
+    int timerfd = -1;
+    int samplefd = -1;
+    int eventsfd = -1;
+    bool group = false; // Leads its own process group
+    bool exited = false;
+};
+
+// Function to start supervising a launched child. Once timeout seconds have
+// passed (0 waits indefinitely) the child's process group, which it must
+// lead, gets SIGTERM and later SIGKILL; its memory is recorded every
+// sampleInterval seconds when the child has somewhere to put samples
+void watchChild(Child& child, double timeout, double sampleInterval);
+
+// Function to return the signal that interrupted the benchmark, or 0.
+// SIGINT, SIGTERM and SIGHUP sent to us are forwarded to the process groups
+// and cgroups of the children, and a child holding the terminal that dies
+// from SIGINT or SIGQUIT counts as well
+int interruption();
+
+// Function to wait until one of the children and its cgroup tree have ended,
+// reaping it and returning its index; grace is the time between SIGTERM and
+// SIGKILL once a child is over its timeout
+size_t waitForChildren(std::vector<Child*>& children, double grace);
+
+#endif // SUPERVISOR_H
@@ -0,0 +1,183 @@
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#include "store.h"
+#include "sweep.h"
+#include "timez.h"
+
+std::vector<ScalePoint> scalePoints;
+std::vector<CpuPoint> cpuPoints;
+
+void runScalingSweep() {
+    for (int level : scaleLevels) {
+        if (verbose) {
+            *verboseStream << "Running at concurrency " << level << std::endl;
+        }
+
+        Benchmark benchmark = newBenchmark(command);
+        benchmark.jobs = level;
+
+        runBenchmark(benchmark);
+        appendHistory(benchmark);
+
+        std::vector<double> wall;
+        for (const auto& run : benchmark.results) {
+            wall.push_back(run.runtime.count());
+        }
+
+        ScalePoint point;
+        point.concurrency = level;
+        point.runs = benchmark.results.size();
+        point.throughput = benchmark.results.size() / benchmark.measuredSeconds;
+        point.latency = summarizeMoments(wall);
+        point.latencies = benchmark.runtimes;
+        scalePoints.push_back(point);
+    }
+}
+
+// Percentiles of one level of a sweep
+static std::string percentiles(const Histogram& histogram) {
+    return "p50 " + formatDuration(valueAtPercentile(histogram, 50))
+         + ", p99 " + formatDuration(valueAtPercentile(histogram, 99))
+         + ", max " + formatDuration(histogram.max);
+}
+
+// Throughput of a single instance, when the sweep does not start at one it
+// is extrapolated linearly from the lowest level
+static double baseThroughput() {
+    const ScalePoint* lowest = &scalePoints.front();
+
+    for (const auto& point : scalePoints) {
+        if (point.concurrency < lowest->concurrency) {
+            lowest = &point;
+        }
+    }
+
+    return lowest->throughput / lowest->concurrency;
+}
+
+void printScalingReport() {
+    double base = baseThroughput();
+    std::vector<double> concurrency, speedup;
+
+    for (const auto& point : scalePoints) {
+        concurrency.push_back(point.concurrency);
+        speedup.push_back(point.throughput / base);
+    }
+
+    ScalingFit amdahl = fitAmdahl(concurrency, speedup);
+    ScalingFit usl = fitUsl(concurrency, speedup);
+
+    *outputStream << std::endl;
+
+    for (size_t i = 0; i < scalePoints.size(); i++) {
+        const ScalePoint& point = scalePoints[i];
+        std::ostringstream row;
+
+        row << point.throughput << " runs/s, speedup " << speedup[i]
+            << " (USL " << predictSpeedup(usl, point.concurrency) << "), efficiency "
+            << speedup[i] / point.concurrency * 100 << "%, latency "
+            << formatDuration(point.latency.mean) << " (" << percentiles(point.latencies) << ")";
+
+        printRow("Concurrency " + std::to_string(point.concurrency), row.str());
+    }
+
+    // Every run of the sweep together, e.g. for the tail over all load levels
+    Histogram all;
+    for (const auto& point : scalePoints) {
+        mergeHistogram(all, point.latencies);
+    }
+    printRow("Latency over all levels", percentiles(all));
+
+    *outputStream << std::endl;
+
+    // Amdahl's law cannot describe throughput that falls with concurrency,
+    // which is what the coherency term of the USL is for
+    std::ostringstream serial, sigma, kappa;
+    if (amdahl.sigma >= 1.0) {
+        serial << "100%, throughput does not grow with concurrency, see the USL rows";
+    } else {
+        serial << amdahl.sigma * 100 << "%";
+    }
+    sigma << usl.sigma;
+    kappa << usl.kappa;
+
+    printRow("Amdahl serial fraction", serial.str());
+    printRow("USL contention (sigma)", sigma.str());
+    printRow("USL coherency (kappa)", kappa.str());
+
+    // Beyond this point adding instances lowers the throughput; the fits
+    // keep both coefficients non-negative, so kappa > 0 means there is one
+    double peak = usl.kappa > 0.0 ? std::sqrt(std::max(1 - usl.sigma, 0.0) / usl.kappa) : 0.0;
+
+    if (usl.sigma >= 1.0 || (usl.kappa > 0.0 && peak <= 1.0)) {
+        printRow("USL peak concurrency", "1, more instances do not help");
+    } else if (usl.kappa > 0.0) {
+        std::ostringstream at;
+        at << peak << " (" << predictSpeedup(usl, peak) * base << " runs/s)";
+        printRow("USL peak concurrency", at.str());
+    } else {
+        printRow("USL peak concurrency", "none, throughput keeps growing");
+    }
+
+    *outputStream << std::endl;
+}
+
+void runCpuSweep() {
+    for (int cpus : cpuSweep) {
+        if (verbose) {
+            *verboseStream << "Running on " << cpus << " CPU(s)" << std::endl;
+        }
+
+        Benchmark benchmark = newBenchmark(command);
+        benchmark.pinnedCpus = cpus;
+
+        runBenchmark(benchmark);
+        appendHistory(benchmark);
+
+        std::vector<double> wall;
+        double busy = 0.0;
+        for (const auto& run : benchmark.results) {
+            double cpuTime = run.usage.ru_utime.tv_sec * 1e6 + run.usage.ru_utime.tv_usec
+                           + run.usage.ru_stime.tv_sec * 1e6 + run.usage.ru_stime.tv_usec;
+            wall.push_back(run.runtime.count());
+            busy += run.runtime.count() > 0 ? cpuTime / run.runtime.count() : 0.0;
+        }
+
+        CpuPoint point;
+        point.cpus = cpus;
+        point.runtime = summarizeMoments(wall);
+        point.runtimes = benchmark.runtimes;
+        point.utilization = busy / benchmark.results.size();
+        cpuPoints.push_back(point);
+    }
+}
+
+// Speedup is relative to the first point of the sweep
+void printCpuSweepReport() {
+    const CpuPoint& first = cpuPoints.front();
+
+    *outputStream << std::endl;
+
+    for (const auto& point : cpuPoints) {
+        double speedup = first.runtime.mean / point.runtime.mean;
+        double scaling = static_cast<double>(point.cpus) / first.cpus;
+        std::ostringstream row;
+
+        row << formatDuration(point.runtime.mean) << " +/- " << formatDuration(point.runtime.stddev)
+            << ", " << point.utilization << " CPUs busy (" << point.utilization / point.cpus * 100
+            << "%), speedup " << speedup << ", efficiency " << speedup / scaling * 100 << "%, "
+            << percentiles(point.runtimes);
+
+        printRow(std::to_string(point.cpus) + " CPU(s)", row.str());
+    }
+
+    Histogram all;
+    for (const auto& point : cpuPoints) {
+        mergeHistogram(all, point.runtimes);
+    }
+    printRow("Runtime over all CPU counts", percentiles(all));
+
+    *outputStream << std::endl;
+}
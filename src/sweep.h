@@ -0,0 +1,41 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <vector>
+#include "histogram.h"
+#include "stats.h"
+
+// Throughput and latency measured at one concurrency level
+struct ScalePoint {
+    int concurrency;
+    size_t runs;
+    double throughput; // Runs per second
+    Summary latency;   // Microseconds
+    Histogram latencies;
+};
+
+// Runtime and utilization of the command pinned to a number of CPUs
+struct CpuPoint {
+    int cpus;
+    Summary runtime;    // Microseconds
+    Histogram runtimes;
+    double utilization; // Mean number of busy CPUs
+};
+
+extern std::vector<ScalePoint> scalePoints;
+extern std::vector<CpuPoint> cpuPoints;
+
+// Function to repeat the benchmark at every --scale concurrency level
+void runScalingSweep();
+
+// Function to print throughput, speedup, efficiency and the fitted models
+void printScalingReport();
+
+// Function to repeat the benchmark with the command pinned to each
+// --cpus-sweep number of CPUs
+void runCpuSweep();
+
+// Function to print runtime, utilization and speedup at every CPU count
+void printCpuSweepReport();
+
+#endif // SWEEP_H
@@ -1,157 +1,851 @@
+#include <algorithm>
+#include <cmath>
 #include <iostream>
-#include <thread>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+
 #include <unistd.h>
 
 #include <sys/resource.h>
 #include <sys/wait.h>
 
+#include "cgroup.h"
+#include "counters.h"
+#include "output.h"
+#include "spawn.h"
+#include "stats.h"
+#include "supervisor.h"
 #include "timez.h"
 
-std::chrono::steady_clock::time_point start_time;
-std::chrono::steady_clock::time_point end_time;
-std::chrono::microseconds runtime;
 std::ostream* outputStream = &std::cout;
-struct rusage usage;
+std::ostream* verboseStream = &std::cout;
+int commandOutput = -1;
+Summary calibration;
+
+// Coefficient of variation of the runtime above which the system is
+// considered noisy
+static const double noisyVariation = 0.1;
+
+// Beyond this many runs the runtime report leans on the histogram: no
+// sorting, no outlier search and no bootstrap over every run
+static const size_t sortedRunLimit = 10000;
+
+static double toMicroseconds(const struct timeval& tv) {
+    return tv.tv_sec * 1e6 + tv.tv_usec;
+}
 
-void executeCommand() {
-    pid_t pid = fork();
+// The first count CPUs we are allowed to run on
+static cpu_set_t firstCpus(int count) {
+    cpu_set_t allowed, selected;
+    CPU_ZERO(&selected);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
 
-    if (pid < 0) {
-        std::cerr << "Failed to fork a new process." << std::endl;
-        dead(1);
+    for (int cpu = 0; cpu < CPU_SETSIZE && count > 0; cpu++) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            CPU_SET(cpu, &selected);
+            count--;
+        }
     }
 
-    if (pid == 0) {
-        std::vector<char*> args;
-        for (const auto& arg : command) {
-            args.push_back(const_cast<char*>(arg.c_str()));
+    return selected;
+}
+
+// A run that has been launched and has not been reaped yet
+struct Instance {
+    RunResult run;
+    ChildSetup setup;
+    Child child;
+    bool cgroupMemory = false;
+    std::vector<int> counterFds;
+};
+
+// Launch one instance of the command, timing the launch itself so the cost
+// of creating the process and the child's startup are included.
+// Calibration launches have no benchmark and skip sampling and cgroups
+static void startInstance(Instance& instance, std::vector<char*>& argv, const Benchmark* benchmark) {
+    ChildSetup& setup = instance.setup;
+    bool measured = benchmark != nullptr;
+    bool tree = measured && useCgroup;
+
+    if (tree) {
+        setup = createRunCgroup();
+    }
+
+    // Memory goes through memory.max where possible, which limits what the
+    // tree actually uses rather than its address space
+    if (measured && maxMemory > 0) {
+        instance.cgroupMemory = tree && limitRunCgroupMemory(setup, maxMemory);
+
+        if (!instance.cgroupMemory) {
+            setup.memoryLimit = maxMemory;
         }
+    }
 
-        args.push_back(nullptr);
+    // The watchdog signals the whole process group of the command
+    setup.processGroup = duration > 0.0;
 
-        if (verbose) {
-            std::cout << "Executing command: ";
-            for (const auto& arg : command) {
-                std::cout << arg << " ";
+    if (measured && benchmark->pinnedCpus > 0) {
+        setup.pinned = true;
+        setup.affinity = firstCpus(benchmark->pinnedCpus);
+    }
+
+    // RLIMIT_CPU has a granularity of whole seconds
+    if (measured && maxCpuTime > 0.0) {
+        setup.cpuLimit = static_cast<rlim_t>(std::ceil(maxCpuTime));
+    }
+
+    setup.stdoutFd = commandOutput;
+
+    // With a cgroup the run ends when the last process of the tree is gone
+    Child& child = instance.child;
+    child.cgroupDir = setup.cgroupDir;
+    child.samples = measured ? &instance.run.memory : nullptr;
+
+    // Only one group at a time can have the terminal
+    child.foreground = !measured || benchmark->jobs == 1;
+
+    child.started = std::chrono::steady_clock::now();
+    child.pid = spawnCommand(argv, spawnMethod, setup);
+    watchChild(child, duration, memoryInterval);
+}
+
+// Collect the measurements of an instance the supervisor has reaped
+static void finishInstance(Instance& instance) {
+    RunResult& run = instance.run;
+    ChildSetup& setup = instance.setup;
+
+    run.runtime = std::chrono::duration_cast<std::chrono::microseconds>(instance.child.ended - instance.child.started);
+    run.status = instance.child.status;
+    run.usage = instance.child.usage;
+    run.termination = instance.child.termination;
+
+    if (setup.cgroupDir >= 0) {
+        run.cgroup = collectRunCgroup(setup);
+    }
+
+    run.limit = Limit::None;
+
+    // Only the cgroup can prove a memory kill, a failed allocation under
+    // RLIMIT_AS looks like any other failure
+    if (run.cgroup.oomKills > 0) {
+        run.limit = Limit::Memory;
+    }
+
+    // Past the soft limit the kernel sends SIGXCPU and at the hard limit
+    // SIGKILL, which the watchdog may send as well
+    double cpuTime = toMicroseconds(run.usage.ru_utime) + toMicroseconds(run.usage.ru_stime);
+    if (setup.cpuLimit != RLIM_INFINITY && WIFSIGNALED(run.status)
+        && (WTERMSIG(run.status) == SIGXCPU
+            || (run.termination == Termination::OnTime && cpuTime >= setup.cpuLimit * 1e6))) {
+        run.limit = Limit::CpuTime;
+    }
+
+    bool failed = !(WIFEXITED(run.status) && WEXITSTATUS(run.status) == 0);
+
+    if (run.limit == Limit::Memory) {
+        std::cerr << "Run was OOM killed after exceeding the memory limit." << std::endl;
+    } else if (run.limit == Limit::CpuTime) {
+        std::cerr << "Run was killed after exceeding the CPU time limit." << std::endl;
+    } else if (failed && setup.memoryLimit != RLIM_INFINITY && run.termination == Termination::OnTime) {
+        std::cerr << "Run failed while --max-memory was set, the limit is not known to be the cause." << std::endl;
+    }
+}
+
+// Launch a command once outside of the benchmark and reap it
+static RunResult launch(const std::vector<std::string>& cmd) {
+    std::vector<char*> argv = buildArgv(cmd);
+    Instance instance;
+
+    startInstance(instance, argv, nullptr);
+    std::vector<Child*> children = {&instance.child};
+    waitForChildren(children, gracePeriod);
+    finishInstance(instance);
+
+    return instance.run;
+}
+
+// A sampled size, which the kernel may not have provided
+static std::string formatSampled(long kilobytes) {
+    return kilobytes < 0 ? "<not available>" : formatMemory(kilobytes);
+}
+
+static void reportRun(const RunResult& run, bool warmup) {
+    int status = run.status;
+
+    if (warmup) {
+        *verboseStream << "Warmup: ";
+    }
+
+    if (WIFEXITED(status)) {
+        *verboseStream << "Command exited with status " << WEXITSTATUS(status) << std::endl;
+    }
+    else if (WIFSIGNALED(status)) {
+        *verboseStream << "Command terminated by signal " << WTERMSIG(status) << std::endl;
+    }
+    else if (WIFSTOPPED(status)) {
+        *verboseStream << "Command stopped by signal " << WSTOPSIG(status) << std::endl;
+    }
+
+    if (run.termination == Termination::Terminated) {
+        *verboseStream << "Command ended after SIGTERM at the end of the duration" << std::endl;
+    } else if (run.termination == Termination::Killed) {
+        *verboseStream << "Command was killed with SIGKILL at the end of the duration" << std::endl;
+    }
+
+    for (const auto& sample : run.memory) {
+        *verboseStream << "Memory at " << formatDuration(sample.time * 1e6) << ": rss " << formatMemory(sample.rss)
+                  << " (anon " << formatSampled(sample.anon) << ", file " << formatSampled(sample.file)
+                  << ", shmem " << formatSampled(sample.shmem) << "), pss " << formatSampled(sample.pss)
+                  << ", uss " << formatSampled(sample.uss) << ", swap " << formatSampled(sample.swap) << std::endl;
+    }
+}
+
+Benchmark newBenchmark(const std::vector<std::string>& command) {
+    Benchmark benchmark;
+    benchmark.command = command;
+    benchmark.jobs = std::max(jobs, 1);
+    return benchmark;
+}
+
+std::vector<RunResult> executeCommand(Benchmark& benchmark, size_t count, bool warmup) {
+    std::vector<RunResult> batch;
+    std::vector<std::unique_ptr<Instance>> running;
+    std::vector<char*> argv = buildArgv(benchmark.command);
+
+    size_t slots = std::max(benchmark.jobs, 1);
+    auto started = std::chrono::steady_clock::now();
+    size_t launched = 0;
+
+    // Keep every slot busy until all instances have been launched
+    while (batch.size() < count) {
+        while (launched < count && running.size() < slots && !interruption()) {
+            std::unique_ptr<Instance> instance(new Instance);
+
+            if (verbose) {
+                *verboseStream << (warmup ? "Executing warmup command: " : "Executing command: ");
+                for (const auto& arg : benchmark.command) {
+                    *verboseStream << arg << " ";
+                }
+                *verboseStream << std::endl;
             }
-            std::cout << std::endl;
+
+            // Counters are opened outside the timed region
+            instance->counterFds = openCounters(counters);
+
+            startInstance(*instance, argv, &benchmark);
+            running.push_back(std::move(instance));
+            launched++;
         }
 
-        execvp(args[0], args.data());
+        std::vector<Child*> children;
+        for (auto& instance : running) {
+            children.push_back(&instance->child);
+        }
+
+        size_t index = waitForChildren(children, gracePeriod);
+        Instance& done = *running[index];
+        finishInstance(done);
 
-        std::cerr << "Failed to execute command." << std::endl;
-        dead(1);
+        done.run.counters = readCounters(done.counterFds);
+
+        if (verbose) {
+            reportRun(done.run, warmup);
+        }
+
+        batch.push_back(done.run);
+        running.erase(running.begin() + index);
+
+        // Stop like the command did once the instances still running are done
+        if (interruption() && running.empty()) {
+            std::cerr << "Interrupted by signal " << interruption() << "." << std::endl;
+            dead(128 + interruption());
+        }
     }
-    else {
-        int status;
 
-        std::thread durationThread;
+    if (!warmup) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        benchmark.measuredSeconds += elapsed.count();
+    }
+
+    return batch;
+}
+
+static std::vector<double> wallTimes(const std::vector<RunResult>& results) {
+    std::vector<double> wall;
+    for (const auto& run : results) {
+        wall.push_back(run.runtime.count());
+    }
+
+    return wall;
+}
+
+// Relative half width of the 95% confidence interval of the mean runtime
+static double relativeConfidence(const std::vector<RunResult>& results) {
+    Summary summary = summarizeMoments(wallTimes(results));
+
+    if (summary.mean <= 0.0) {
+        return 0.0;
+    }
+
+    return confidenceHalfWidth(summary) / summary.mean;
+}
+
+void calibrate() {
+    // A command that does nothing, so all that is left is our own overhead
+    std::vector<std::string> noop = {access("/bin/true", X_OK) == 0 ? "/bin/true" : "true"};
 
-        // Check if duration is greater than 0.0
-        if (duration > 0.0) {
-            durationThread = std::thread([pid]() {
-                std::this_thread::sleep_for(
-                    std::chrono::duration<double>(duration));
-                    if (kill(pid, 0) == 0) {
-                        std::cerr << "Duration exceeded. Killing process " << pid
-                                << std::endl;
-                        kill(pid, SIGKILL);
-                    }
-                });
+    for (int i = 0; i < 10; i++) {
+        launch(noop);
+    }
+
+    std::vector<double> samples;
+    for (int i = 0; i < 200; i++) {
+        samples.push_back(launch(noop).runtime.count());
+    }
+
+    calibration = summarize(samples);
+}
+
+// Store a measured run, taking away the calibrated overhead if requested.
+// The launch overhead is skewed to the right, so its median is taken; a
+// run within the confidence interval of it cannot be told from a no-op
+static void record(Benchmark& benchmark, RunResult run) {
+    if (subtractOverhead) {
+        auto overhead = std::chrono::microseconds(std::lround(calibration.median));
+
+        if (run.runtime.count() <= calibration.median + confidenceHalfWidth(calibration)) {
+            benchmark.withinOverhead++;
         }
 
-        start_time = std::chrono::steady_clock::now();
-        waitpid(pid, &status, 0);
-        end_time = std::chrono::steady_clock::now();
+        run.runtime = std::max(run.runtime - overhead, std::chrono::microseconds(0));
+    }
+
+    writeRecord(benchmark, run);
+    recordValue(benchmark.runtimes, run.runtime.count());
+    benchmark.results.push_back(run);
+}
+
+// Each run launches the configured number of concurrent instances
+static size_t instances(const Benchmark& benchmark) {
+    return std::max(benchmark.jobs, 1);
+}
+
+void runWarmup(Benchmark& benchmark) {
+    // Warmup runs fill caches and are thrown away
+    if (warmup > 0) {
+        executeCommand(benchmark, warmup * instances(benchmark), true);
+    }
+}
 
-        // If the duration thread was created, join it
-        if (durationThread.joinable()) {
-            durationThread.join();
+void runRound(Benchmark& benchmark) {
+    for (const auto& run : executeCommand(benchmark, instances(benchmark))) {
+        record(benchmark, run);
+    }
+}
+
+bool precisionReached(const Benchmark& benchmark) {
+    // In precision mode --runs is the minimum
+    size_t minimumRuns = std::max(runs, 3);
+    return benchmark.results.size() >= minimumRuns && relativeConfidence(benchmark.results) <= precision;
+}
+
+bool precisionExhausted(size_t runCount, double elapsedSeconds) {
+    // Without any explicit bound the number of runs is capped so noisy
+    // commands still terminate
+    size_t maximumRuns = maxRuns;
+    if (maxRuns <= 0 && maxTime <= 0.0) {
+        maximumRuns = 1000;
+    }
+
+    if (maximumRuns > 0 && runCount >= maximumRuns) {
+        return true;
+    }
+
+    return maxTime > 0.0 && elapsedSeconds >= maxTime;
+}
+
+void runBenchmark(Benchmark& benchmark) {
+    runWarmup(benchmark);
+
+    if (precision <= 0.0) {
+        for (const auto& run : executeCommand(benchmark, runs * instances(benchmark))) {
+            record(benchmark, run);
         }
+        return;
+    }
 
-        runtime = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
+    auto started = std::chrono::steady_clock::now();
 
-        if (verbose) {
-            if (WIFEXITED(status)) {
-                std::cout << "Command exited with status " << WEXITSTATUS(status) << std::endl;
-            }
-            else if (WIFSIGNALED(status)) {
-                std::cout << "Command terminated by signal " << WTERMSIG(status) << std::endl;
-            }
-            else if (WIFSTOPPED(status)) {
-                std::cout << "Command stopped by signal " << WSTOPSIG(status) << std::endl;
-            }
+    while (true) {
+        runRound(benchmark);
+
+        if (precisionReached(benchmark)) {
+            return;
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        if (precisionExhausted(benchmark.results.size(), elapsed.count())) {
+            break;
         }
     }
+
+    std::cerr << "Warning: precision target not reached after " << benchmark.results.size()
+              << " runs." << std::endl;
+}
+
+void printRow(const std::string& label, const std::string& value) {
+    *outputStream << std::left << std::setw(32) << label << "\t\t\t\t-->\t\t" << value << std::endl;
+}
+
+static void printSummary(const std::string& label, const Summary& summary) {
+    printRow(label + " (mean +/- sd)",
+             formatDuration(summary.mean) + " +/- " + formatDuration(summary.stddev));
+    printRow(label + " (median)", formatDuration(summary.median));
+    printRow(label + " (min ... max)",
+             formatDuration(summary.min) + " ... " + formatDuration(summary.max));
+}
+
+void printCalibration() {
+    *outputStream << std::endl;
+
+    printRow("Harness overhead (mean +/- sd)",
+             formatDuration(calibration.mean) + " +/- " + formatDuration(calibration.stddev));
+    printRow("Harness overhead (median)", formatDuration(calibration.median));
+    printRow("Harness overhead 95% CI", "+/- " + formatDuration(confidenceHalfWidth(calibration)));
+
+    if (subtractOverhead) {
+        printRow("Subtracted from each run", formatDuration(std::lround(calibration.median)));
+    }
+
+    *outputStream << std::endl;
 }
 
-void measureResources() {
-    int ret = getrusage(RUSAGE_CHILDREN, &usage);
+// Summary of the runtimes, with the median and extremes read from the
+// histogram once there are too many runs to sort
+static Summary runtimeSummary(const Benchmark& benchmark) {
+    std::vector<double> wall = wallTimes(benchmark.results);
 
-    if (ret == EFAULT) {
-        std::cerr << "Cannot measure resources due to inaccessible address space." << std::endl;
-        dead(1);
+    if (wall.size() <= sortedRunLimit) {
+        return summarize(wall);
     }
-    else if (ret == EINVAL) {
-        std::cerr << "Invalid CHILD process" << std::endl;
-        dead(1);
+
+    Summary summary = summarizeMoments(wall);
+    summary.median = valueAtPercentile(benchmark.runtimes, 50);
+    summary.min = benchmark.runtimes.min;
+    summary.max = benchmark.runtimes.max;
+    return summary;
+}
+
+// Bootstrap intervals of the mean and the median
+static void printIntervals(const std::string& label, const std::vector<double>& samples,
+                           std::string (*format)(double)) {
+    Bootstrap intervals = bootstrap(samples);
+
+    printRow(label + " mean 95% CI",
+             format(intervals.mean.low) + " ... " + format(intervals.mean.high));
+    printRow(label + " median 95% CI",
+             format(intervals.median.low) + " ... " + format(intervals.median.high));
+}
+
+// Tail latency from the runtime histogram, drawn as well once there are
+// enough runs for its shape to mean something
+static void printPercentiles(const Histogram& runtimes) {
+    static const double percentiles[] = {50, 90, 99, 99.9};
+
+    for (double percentile : percentiles) {
+        std::ostringstream label;
+        label << "Runtime p" << percentile;
+        printRow(label.str(), formatDuration(valueAtPercentile(runtimes, percentile)));
     }
-    else if (ret != 0) {
-        std::cerr << "Unknown error while measuring resources." << std::endl;
-        dead(1);
+    printRow("Runtime max", formatDuration(runtimes.max));
+
+    if (runtimes.total >= 20) {
+        *outputStream << std::endl;
+        printHistogram(*outputStream, runtimes, 10, formatDuration);
+        *outputStream << std::endl;
     }
 }
 
-void printResourceUsage() {
+void printResourceUsage(const Benchmark& benchmark) {
+    const std::vector<RunResult>& results = benchmark.results;
+
     *outputStream << std::endl;
 
-    if (usage.ru_maxrss > 1024) {
-        *outputStream << "Memory used                     \t\t\t\t-->\t\t" << usage.ru_maxrss / 1024 << " MB" << std::endl;
-    } else {
-        *outputStream << "Memory used                     \t\t\t\t-->\t\t" << usage.ru_maxrss << " KB" << std::endl;
+    long maxrss = 0;
+    long minrss = results.front().usage.ru_maxrss;
+    for (const auto& run : results) {
+        maxrss = std::max(maxrss, run.usage.ru_maxrss);
+        minrss = std::min(minrss, run.usage.ru_maxrss);
+    }
+
+    printRow("Memory used", formatMemory(maxrss));
+
+    if (results.size() > 1) {
+        printRow("Memory used (min ... max)", formatMemory(minrss) + " ... " + formatMemory(maxrss));
+    }
+
+    if (duration > 0.0) {
+        size_t terminated = 0, killed = 0;
+        for (const auto& run : results) {
+            terminated += run.termination == Termination::Terminated;
+            killed += run.termination == Termination::Killed;
+        }
+
+        std::ostringstream ended;
+        ended << results.size() - terminated - killed << " on time, "
+              << terminated << " by SIGTERM, " << killed << " by SIGKILL";
+        printRow("Runs ended", ended.str());
     }
 
-    // Convert microseconds to seconds
-    double seconds = runtime.count() / 1e6;
-    
-    if (seconds > 1.0) {
-        *outputStream << "Runtime                         \t\t\t\t-->\t\t" << seconds << " s" << std::endl;
-    } else if (runtime.count() > 1000) {
-        *outputStream << "Runtime                         \t\t\t\t-->\t\t" << runtime.count() / 1000 << " ms" << std::endl;
+    if (results.size() == 1) {
+        printRow("Runtime", formatDuration(results.front().runtime.count()));
     } else {
-        *outputStream << "Runtime                         \t\t\t\t-->\t\t" << runtime.count() << " us" << std::endl;
+        std::vector<double> user, system;
+        for (const auto& run : results) {
+            user.push_back(toMicroseconds(run.usage.ru_utime));
+            system.push_back(toMicroseconds(run.usage.ru_stime));
+        }
+
+        printRow("Runs", std::to_string(results.size()));
+
+        if (benchmark.outliers > 0) {
+            printRow("Outliers (MAD)", std::to_string(benchmark.outliers) + (excludeOutliers ? ", excluded" : ", included"));
+        }
+
+        if (benchmark.jobs > 1) {
+            std::ostringstream throughput;
+            throughput << results.size() / benchmark.measuredSeconds << " runs/s";
+            printRow("Concurrent instances", std::to_string(benchmark.jobs));
+            printRow("Throughput", throughput.str());
+        }
+
+        size_t limited = std::count_if(results.begin(), results.end(),
+                                       [](const RunResult& run) { return run.limit != Limit::None; });
+        if (limited > 0) {
+            printRow("Runs over a limit", std::to_string(limited));
+        }
+
+        if (precision > 0.0) {
+            std::ostringstream ci;
+            ci << "+/- " << relativeConfidence(results) * 100 << "% (target " << precision * 100 << "%)";
+            printRow("Runtime 95% CI", ci.str());
+        }
+
+        printSummary("Runtime", runtimeSummary(benchmark));
+        printPercentiles(benchmark.runtimes);
+        printSummary("User time", summarize(user));
+        printSummary("System time", summarize(system));
+
+        // A handful of runs give too few distinct resamples for an interval,
+        // and past the limit the percentiles above say more for less
+        if (results.size() >= 5 && results.size() <= sortedRunLimit) {
+            std::vector<double> rss;
+            for (const auto& run : results) {
+                rss.push_back(run.usage.ru_maxrss);
+            }
+
+            *outputStream << std::endl;
+            printIntervals("Runtime", wallTimes(results), formatDuration);
+            printIntervals("User time", user, formatDuration);
+            printIntervals("System time", system, formatDuration);
+            printIntervals("Memory used", rss, [](double kilobytes) { return formatMemory(std::lround(kilobytes)); });
+        }
     }
 
     *outputStream << std::endl;
 }
 
-void printExtraInfo() {
-    // User CPU time in microseconds
-    double userSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
-    if (userSeconds > 1.0) {
-        *outputStream << "CPU time used in user mode      \t\t\t\t-->\t\t" << userSeconds << " s" << std::endl;
-    } else if (usage.ru_utime.tv_usec > 1000) {
-        *outputStream << "CPU time used in user mode      \t\t\t\t-->\t\t" << usage.ru_utime.tv_usec / 1000 << " ms" << std::endl;
-    } else {
-        *outputStream << "CPU time used in user mode      \t\t\t\t-->\t\t" << usage.ru_utime.tv_usec << " us" << std::endl;
+void printExtraInfo(const Benchmark& benchmark) {
+    const std::vector<RunResult>& results = benchmark.results;
+
+    // With a single run print its CPU times, otherwise they are summarized above
+    if (results.size() == 1) {
+        const struct rusage& usage = results.front().usage;
+        printRow("CPU time used in user mode", formatDuration(toMicroseconds(usage.ru_utime)));
+        printRow("CPU time used in system mode", formatDuration(toMicroseconds(usage.ru_stime)));
+    }
+
+    // Counters are averaged over all runs
+    double minflt = 0, majflt = 0, inblock = 0, oublock = 0, nvcsw = 0, nivcsw = 0;
+    for (const auto& run : results) {
+        minflt += run.usage.ru_minflt;
+        majflt += run.usage.ru_majflt;
+        inblock += run.usage.ru_inblock;
+        oublock += run.usage.ru_oublock;
+        nvcsw += run.usage.ru_nvcsw;
+        nivcsw += run.usage.ru_nivcsw;
+    }
+
+    double n = results.size();
+    printRow("Page reclaims (Soft-Page Fault)", std::to_string(std::lround(minflt / n)));
+    printRow("Page faults (Hard-Page Fault)", std::to_string(std::lround(majflt / n)));
+    printRow("Number of input block(s)", std::to_string(std::lround(inblock / n)));
+    printRow("Number of output block(s)", std::to_string(std::lround(oublock / n)));
+    printRow("Voluntary context switches", std::to_string(std::lround(nvcsw / n)));
+    printRow("Involuntary context switches", std::to_string(std::lround(nivcsw / n)));
+
+    *outputStream << std::endl;
+}
+
+// Mean of a counter over all runs, NaN if it could not be counted
+static double counterMean(const std::vector<RunResult>& results, size_t index) {
+    double sum = 0.0;
+    for (const auto& run : results) {
+        sum += run.counters[index];
     }
 
-    // System CPU time in microseconds
-    double systemSeconds = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
-    if (systemSeconds > 1.0) {
-        *outputStream << "CPU time used in system mode    \t\t\t\t-->\t\t" << systemSeconds << " s" << std::endl;
-    } else if (usage.ru_stime.tv_usec > 1000) {
-        *outputStream << "CPU time used in system mode    \t\t\t\t-->\t\t" << usage.ru_stime.tv_usec / 1000 << " ms" << std::endl;
+    return sum / results.size();
+}
+
+static double counterMean(const std::vector<RunResult>& results, const std::string& name) {
+    for (size_t i = 0; i < counters.size(); i++) {
+        if (counters[i].name == name) {
+            return counterMean(results, i);
+        }
+    }
+
+    return NAN;
+}
+
+static void printRatio(const std::string& label, double numerator, double denominator, bool percent) {
+    if (std::isnan(numerator) || std::isnan(denominator) || denominator == 0.0) {
+        return;
+    }
+
+    std::ostringstream value;
+    if (percent) {
+        value << numerator / denominator * 100 << " %";
     } else {
-        *outputStream << "CPU time used in system mode    \t\t\t\t-->\t\t" << usage.ru_stime.tv_usec << " us" << std::endl;
+        value << numerator / denominator;
+    }
+
+    printRow(label, value.str());
+}
+
+void printCounters(const Benchmark& benchmark) {
+    const std::vector<RunResult>& results = benchmark.results;
+
+    for (size_t i = 0; i < counters.size(); i++) {
+        if (counters[i].hidden) {
+            continue;
+        }
+
+        double value = counterMean(results, i);
+
+        if (std::isnan(value)) {
+            printRow(counters[i].name, "<not supported>");
+        } else {
+            printRow(counters[i].name, std::to_string(std::llround(value)));
+        }
     }
 
-    *outputStream << "Page reclaims (Soft-Page Fault) \t\t\t\t-->\t\t" << usage.ru_minflt << std::endl;
-    *outputStream << "Page faults (Hard-Page Fault)   \t\t\t\t-->\t\t" << usage.ru_majflt << std::endl;
-    *outputStream << "Number of input block(s)        \t\t\t\t-->\t\t" << usage.ru_inblock << std::endl;
-    *outputStream << "Number of output block(s)       \t\t\t\t-->\t\t" << usage.ru_oublock << std::endl;
-    *outputStream << "Voluntary context switches      \t\t\t\t-->\t\t" << usage.ru_nvcsw << std::endl;
-    *outputStream << "Involuntary context switches    \t\t\t\t-->\t\t" << usage.ru_nivcsw << std::endl;
+    printRatio("Instructions per cycle", counterMean(results, "instructions"), counterMean(results, "cycles"), false);
+    printRatio("Cache miss rate", counterMean(results, "cache-misses"), counterMean(results, "cache-references"), true);
+    printRatio("Branch miss rate", counterMean(results, "branch-misses"), counterMean(results, "branches"), true);
 
     *outputStream << std::endl;
 }
+
+void printMemoryProfile(const Benchmark& benchmark) {
+    // Fields no sample had stay negative
+    MemorySample peak;
+    double averageRss = 0.0;
+    double timeToPeak = 0.0;
+    size_t sampledRuns = 0;
+    size_t sampleCount = 0;
+
+    for (const auto& run : benchmark.results) {
+        if (run.memory.empty()) {
+            continue;
+        }
+
+        double sum = 0.0;
+        const MemorySample* runPeak = &run.memory.front();
+
+        for (const auto& sample : run.memory) {
+            sum += sample.rss;
+
+            if (sample.rss > runPeak->rss) {
+                runPeak = &sample;
+            }
+
+            peak.rss = std::max(peak.rss, sample.rss);
+            peak.anon = std::max(peak.anon, sample.anon);
+            peak.file = std::max(peak.file, sample.file);
+            peak.shmem = std::max(peak.shmem, sample.shmem);
+            peak.pss = std::max(peak.pss, sample.pss);
+            peak.uss = std::max(peak.uss, sample.uss);
+            peak.swap = std::max(peak.swap, sample.swap);
+        }
+
+        averageRss += sum / run.memory.size();
+        timeToPeak += runPeak->time;
+        sampleCount += run.memory.size();
+        sampledRuns++;
+    }
+
+    printRow("Memory samples", std::to_string(sampleCount));
+
+    // Commands shorter than the interval finish before the first sample
+    if (sampledRuns == 0) {
+        *outputStream << std::endl;
+        return;
+    }
+
+    printRow("Peak RSS (sampled)", formatMemory(peak.rss));
+    printRow("Average RSS", formatMemory(std::lround(averageRss / sampledRuns)));
+    printRow("Time to peak RSS", formatDuration(timeToPeak / sampledRuns * 1e6));
+    printRow("Peak anonymous RSS", formatSampled(peak.anon));
+    printRow("Peak file RSS", formatSampled(peak.file));
+    printRow("Peak shared memory RSS", formatSampled(peak.shmem));
+    printRow("Peak PSS", formatSampled(peak.pss));
+    printRow("Peak USS", formatSampled(peak.uss));
+    printRow("Peak swap", formatSampled(peak.swap));
+
+    *outputStream << std::endl;
+}
+
+// Mean of a cgroup statistic over all runs, negative if it is missing
+static double cgroupMean(const std::vector<RunResult>& results, double CgroupStats::*field) {
+    double sum = 0.0;
+    for (const auto& run : results) {
+        if (run.cgroup.*field < 0) {
+            return -1;
+        }
+        sum += run.cgroup.*field;
+    }
+
+    return sum / results.size();
+}
+
+static double cgroupMean(const std::vector<RunResult>& results, long CgroupStats::*field) {
+    double sum = 0.0;
+    for (const auto& run : results) {
+        if (run.cgroup.*field < 0) {
+            return -1;
+        }
+        sum += run.cgroup.*field;
+    }
+
+    return sum / results.size();
+}
+
+static void printCgroupRow(const std::string& label, double value, const std::string& formatted) {
+    printRow(label, value < 0 ? "<not available>" : formatted);
+}
+
+void printCgroupStats(const Benchmark& benchmark) {
+    const std::vector<RunResult>& results = benchmark.results;
+
+    double usage = cgroupMean(results, &CgroupStats::cpuUsage);
+    double user = cgroupMean(results, &CgroupStats::cpuUser);
+    double system = cgroupMean(results, &CgroupStats::cpuSystem);
+    double memory = cgroupMean(results, &CgroupStats::memoryPeak);
+    double readBytes = cgroupMean(results, &CgroupStats::ioReadBytes);
+    double writeBytes = cgroupMean(results, &CgroupStats::ioWriteBytes);
+    double reads = cgroupMean(results, &CgroupStats::ioReads);
+    double writes = cgroupMean(results, &CgroupStats::ioWrites);
+    double processes = cgroupMean(results, &CgroupStats::processes);
+
+    // Process tree totals are averaged over all runs
+    printCgroupRow("Tree CPU time", usage, formatDuration(usage));
+    printCgroupRow("Tree CPU time in user mode", user, formatDuration(user));
+    printCgroupRow("Tree CPU time in system mode", system, formatDuration(system));
+    printCgroupRow("Tree peak memory", memory, formatMemory(std::lround(memory)));
+    printCgroupRow("Tree bytes read", readBytes, formatMemory(std::lround(readBytes / 1024)));
+    printCgroupRow("Tree bytes written", writeBytes, formatMemory(std::lround(writeBytes / 1024)));
+    printCgroupRow("Tree read operations", reads, std::to_string(std::lround(reads)));
+    printCgroupRow("Tree write operations", writes, std::to_string(std::lround(writes)));
+    printCgroupRow("Tree peak process count", processes, std::to_string(std::lround(processes)));
+
+    *outputStream << std::endl;
+}
+
+// Count the runtime outliers, warn about signs of interference and drop
+// the outliers from the results of benchmark when asked to
+static void checkOutliers(Benchmark& benchmark) {
+    std::vector<RunResult>& results = benchmark.results;
+    std::vector<double> wall = wallTimes(results);
+
+    // The MAD needs two sorted copies of every run, which is not worth it
+    // once a single outlier hardly moves the percentiles
+    if (wall.size() > sortedRunLimit) {
+        if (excludeOutliers) {
+            std::cerr << "Warning: Outliers are not looked for past " << sortedRunLimit
+                      << " runs, all runs are included." << std::endl;
+        }
+    } else {
+        std::vector<bool> flagged = findOutliers(wall);
+
+        size_t outliers = std::count(flagged.begin(), flagged.end(), true);
+        benchmark.outliers = outliers;
+
+        if (wall.size() < 3) {
+            return;
+        }
+
+        double median = summarize(wall).median;
+
+        if (flagged.front() && wall.front() > median) {
+            std::cerr << "Warning: The first run took " << formatDuration(wall.front())
+                      << ", much longer than the median of " << formatDuration(median)
+                      << ". Caches may have been cold, consider --warmup." << std::endl;
+        }
+
+        if (outliers > 0 && !excludeOutliers) {
+            std::cerr << "Warning: " << outliers << " of " << wall.size()
+                      << " runs are outliers, consider a quieter system or --exclude-outliers." << std::endl;
+        }
+
+        if (excludeOutliers) {
+            std::vector<RunResult> kept;
+            for (size_t i = 0; i < results.size(); i++) {
+                if (!flagged[i]) {
+                    kept.push_back(results[i]);
+                }
+            }
+            results.swap(kept);
+
+            benchmark.runtimes = Histogram();
+            for (const auto& run : results) {
+                recordValue(benchmark.runtimes, run.runtime.count());
+            }
+        }
+    }
+
+    Summary summary = summarizeMoments(wallTimes(results));
+
+    if (summary.stddev / summary.mean > noisyVariation) {
+        std::cerr << "Warning: The runtime varies by " << std::lround(summary.stddev / summary.mean * 100)
+                  << "% (coefficient of variation), other processes may be interfering." << std::endl;
+    }
+}
+
+void printReport(Benchmark& benchmark) {
+    if (benchmark.withinOverhead > 0) {
+        std::cerr << "Warning: " << benchmark.withinOverhead << " of " << benchmark.results.size()
+                  << " runs took no longer than the harness overhead, their runtime after subtracting it"
+                  << " is not meaningful." << std::endl;
+    }
+
+    checkOutliers(benchmark);
+
+    printResourceUsage(benchmark);
+
+    if (verbose) {
+        printExtraInfo(benchmark);
+    }
+
+    if (!counters.empty()) {
+        printCounters(benchmark);
+    }
+
+    if (memoryInterval > 0.0) {
+        printMemoryProfile(benchmark);
+    }
+
+    if (useCgroup) {
+        printCgroupStats(benchmark);
+    }
+}
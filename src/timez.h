@@ -5,25 +5,103 @@
 #include <string>
 #include <vector>
 #include <chrono>
+#include <sys/resource.h>
 #include "args.h"
+#include "cgroup.h"
+#include "histogram.h"
+#include "sampler.h"
+#include "supervisor.h"
+#include "stats.h"
 #include "utils.h"
 
+// Resource limit that ended a run
+enum class Limit {
+    None,
+    Memory,
+    CpuTime
+};
+
+// Timing and resource usage of a single run of the command
+struct RunResult {
+    std::chrono::microseconds runtime;
+    struct rusage usage;
+    int status;
+    std::vector<double> counters;
+    std::vector<MemorySample> memory;
+    CgroupStats cgroup;
+    Limit limit;
+    Termination termination;
+};
+
+// One configuration of a command that is measured and the runs measured for it
+struct Benchmark {
+    std::string label;  // e.g. "./bench, threads=2, size=1k"
+    std::string values; // e.g. "threads=2, size=1k"
+    std::vector<std::string> command;
+    int jobs = 1;       // Instances running at once
+    int pinnedCpus = 0; // CPUs the instances are pinned to, 0 for all
+    std::vector<RunResult> results;
+    Histogram runtimes;
+    double measuredSeconds = 0.0;
+    size_t outliers = 0; // Runtime outliers, counted by the report
+    size_t withinOverhead = 0; // Runs as short as the harness overhead, with --subtract-overhead
+};
+
 extern std::ostream* outputStream;
-extern std::chrono::steady_clock::time_point start_time;
-extern std::chrono::steady_clock::time_point end_time;
-extern std::chrono::microseconds runtime;
-extern struct rusage usage; 
+extern std::ostream* verboseStream; // Progress shown by --verbose
+extern int commandOutput;           // Stdout of the command when not ours, or -1
+extern Summary calibration;
+
+// Function to return a benchmark of command with the --jobs of the options
+Benchmark newBenchmark(const std::vector<std::string>& command);
+
+// Function to execute the command of benchmark count times, keeping up to
+// its jobs instances running at once, and return the measurements of every
+// run; warmup runs are only marked as such in verbose output
+std::vector<RunResult> executeCommand(Benchmark& benchmark, size_t count = 1, bool warmup = false);
+
+// Function to measure the overhead of launching a no-op command
+void calibrate();
+
+// Function to run the warmup runs, which are not recorded
+void runWarmup(Benchmark& benchmark);
+
+// Function to run every concurrent instance once into the results of benchmark
+void runRound(Benchmark& benchmark);
 
-// Function to execute given command
-void executeCommand();
+// Function to tell whether the results of benchmark meet the --precision target
+bool precisionReached(const Benchmark& benchmark);
 
-// Function to measure resources
-void measureResources();
+// Function to tell whether --max-runs, --max-time or the default cap end
+// precision mode before the target is met
+bool precisionExhausted(size_t runCount, double elapsedSeconds);
+
+// Function to run the warmup and measured runs into the results of benchmark
+void runBenchmark(Benchmark& benchmark);
+
+// Function to print one aligned row of the report
+void printRow(const std::string& label, const std::string& value);
+
+// Function to print the measured harness overhead
+void printCalibration();
 
 // Function to print resource usage
-void printResourceUsage();
+void printResourceUsage(const Benchmark& benchmark);
 
 // Function to print extra information when verbose is enabled
-void printExtraInfo();
+void printExtraInfo(const Benchmark& benchmark);
+
+// Function to print performance counters and the ratios derived from them
+void printCounters(const Benchmark& benchmark);
+
+// Function to print peak, average and time to peak of the sampled memory
+void printMemoryProfile(const Benchmark& benchmark);
+
+// Function to print the totals of the whole process tree from the run cgroups
+void printCgroupStats(const Benchmark& benchmark);
+
+// Function to print every report enabled by the options for benchmark,
+// dropping its outliers first when --exclude-outliers asks to
+void printReport(Benchmark& benchmark);
 
 #endif // TIMEZ_H
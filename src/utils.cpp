@@ -1,4 +1,9 @@
+#include <cctype>
+#include <cmath>
 #include <fstream>
+#include <sstream>
+#include "cgroup.h"
+#include "output.h"
 #include "utils.h"
 
 std::ofstream fileStream;
@@ -10,9 +15,172 @@ void dead(int exitCode) {
 }
 
 void cleanup() {
+    finishRecords();
+
     if (fileStream.is_open()) {
         fileStream.close();
     }
 
+    cleanupCgroups();
+
     // Do more cleanup here
 }   
+
+std::string formatDuration(double microseconds) {
+    std::ostringstream out;
+
+    if (microseconds > 1e6) {
+        out << microseconds / 1e6 << " s";
+    } else if (microseconds > 1000) {
+        out << microseconds / 1000 << " ms";
+    } else {
+        out << microseconds << " us";
+    }
+
+    return out.str();
+}
+
+std::string formatMemory(long kilobytes) {
+    std::ostringstream out;
+
+    if (kilobytes > 1024) {
+        out << kilobytes / 1024 << " MB";
+    } else {
+        out << kilobytes << " KB";
+    }
+
+    return out.str();
+}
+
+long long parseSize(const std::string& text) {
+    size_t end = 0;
+    double value;
+
+    try {
+        value = std::stod(text, &end);
+    } catch (const std::exception&) {
+        return -1;
+    }
+
+    std::string unit = text.substr(end);
+    for (auto& c : unit) {
+        c = std::toupper(c);
+    }
+
+    // Binary units, with or without a trailing B or iB
+    if (unit.size() > 1 && unit.back() == 'B') {
+        unit.pop_back();
+    }
+    if (unit.size() > 1 && unit.back() == 'I') {
+        unit.pop_back();
+    }
+
+    static const std::string units = "BKMGT";
+    size_t power = unit.empty() ? 0 : units.find(unit);
+
+    if (value < 0 || unit.size() > 1 || power == std::string::npos) {
+        return -1;
+    }
+
+    return static_cast<long long>(value * std::pow(1024.0, power));
+}
+
+double parsePercentage(const std::string& text) {
+    // The value is a percentage, with or without the trailing '%'
+    std::string value = text;
+    if (!value.empty() && value.back() == '%') {
+        value.pop_back();
+    }
+
+    size_t end = 0;
+    double percentage;
+
+    try {
+        percentage = std::stod(value, &end);
+    } catch (const std::exception&) {
+        return -1;
+    }
+
+    if (end != value.size() || percentage < 0) {
+        return -1;
+    }
+
+    return percentage / 100.0;
+}
+
+bool parseCountList(const std::string& text, std::vector<int>& counts) {
+    std::istringstream in(text);
+    std::string item;
+
+    while (std::getline(in, item, ',')) {
+        size_t range = item.find("..");
+
+        try {
+            if (range == std::string::npos) {
+                counts.push_back(std::stoi(item));
+            } else {
+                int first = std::stoi(item.substr(0, range));
+                int last = std::stoi(item.substr(range + 2));
+
+                for (int i = first; i <= last; i++) {
+                    counts.push_back(i);
+                }
+            }
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    for (int count : counts) {
+        if (count < 1) {
+            return false;
+        }
+    }
+
+    return !counts.empty();
+}
+
+bool splitCommand(const std::string& text, std::vector<std::string>& words) {
+    std::string word;
+    bool inWord = false;
+    char quote = 0;
+
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+
+        if (quote == '\'') {
+            if (c == '\'') {
+                quote = 0;
+            } else {
+                word += c;
+            }
+        } else if (c == '\\' && i + 1 < text.size() && quote != '\'') {
+            word += text[++i];
+            inWord = true;
+        } else if (quote == '"') {
+            if (c == '"') {
+                quote = 0;
+            } else {
+                word += c;
+            }
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+            inWord = true;
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
+            if (inWord) {
+                words.push_back(word);
+                word.clear();
+                inWord = false;
+            }
+        } else {
+            word += c;
+            inWord = true;
+        }
+    }
+
+    if (inWord) {
+        words.push_back(word);
+    }
+
+    return quote == 0 && !words.empty();
+}
@@ -2,6 +2,8 @@
 #define UTILS_H
 
 #include <fstream>
+#include <string>
+#include <vector>
 
 extern std::ofstream fileStream;
 
@@ -11,4 +13,24 @@ void dead(int exitCode);
 // Function to clear resources before exiting
 void cleanup();
 
+// Function to format a duration in microseconds with a readable unit
+std::string formatDuration(double microseconds);
+
+// Function to format a memory size in kilobytes with a readable unit
+std::string formatMemory(long kilobytes);
+
+// Function to parse a size such as 512M or 2G into bytes, returns -1 on error
+long long parseSize(const std::string& text);
+
+// Function to parse a percentage such as 5% or 5 into a fraction, returns
+// -1 on error
+double parsePercentage(const std::string& text);
+
+// Function to parse a list of positive counts such as 1,2,4 or 1..8
+bool parseCountList(const std::string& text, std::vector<int>& counts);
+
+// Function to split a command line into words the way a shell would quote
+// them, without any expansion; returns false on an unterminated quote
+bool splitCommand(const std::string& text, std::vector<std::string>& words);
+
 #endif // UTILS_H